@@ -0,0 +1,266 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "adpcm.h"
+
+#include <cmath>
+#include <cstring>
+#include <limits>
+
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define ADPCM_X86_SIMD
+#endif
+
+alignas(32) static const s32 adpcmStepTable[ADPCM_STEP_COUNT] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17, 19, 21, 23, 25, 28, 31, 34, 37, 41, 45, 50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307, 337, 371, 408, 449, 494, 544, 598, 658, 724, 796, 876, 963, 1060,
+    1166, 1282, 1411, 1552, 1707, 1878, 2066, 2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358, 5894, 6484, 7132,
+    7845, 8630, 9493, 10442, 11487, 12635, 13899, 15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767,
+};
+
+// one code through the decoder, the encoder runs it too so both sides track the same predictor
+static inline void adpcmStep(u8 pCode, s32 &pPredictor, s32 &pIndex) {
+    s32 step = adpcmStepTable[pIndex];
+    s32 diff = step >> 3;
+
+    if (pCode & 4)
+    {
+        diff += step;
+    }
+
+    if (pCode & 2)
+    {
+        diff += step >> 1;
+    }
+
+    if (pCode & 1)
+    {
+        diff += step >> 2;
+    }
+
+    pPredictor = pCode & 8 ? pPredictor - diff : pPredictor + diff;
+    pPredictor = std::min(std::max(pPredictor, -32768), 32767);
+
+    pIndex += pCode & 4 ? ((pCode & 3) + 1) * 2 : -1;
+    pIndex = std::min(std::max(pIndex, 0), ADPCM_STEP_COUNT - 1);
+}
+
+f64 AdpcmError::snr() const {
+    if (errorSquares == 0)
+    {
+        return std::numeric_limits<f64>::infinity();
+    }
+
+    return 10.0 * std::log10(signalSquares / errorSquares);
+}
+
+u32 adpcmBlocksFor(size_t pCount) {
+    return (pCount + SFS_ADPCM_SAMPLES_PER_BLOCK - 1) / SFS_ADPCM_SAMPLES_PER_BLOCK;
+}
+
+void adpcmEncode(const s16 *pSrc, size_t pCount, u8 *pDst, u8 &pStepIndex, AdpcmError &pError) {
+    s32 index = std::min<s32>(pStepIndex, ADPCM_STEP_COUNT - 1);
+
+    for (size_t first = 0; first < pCount; first += SFS_ADPCM_SAMPLES_PER_BLOCK)
+    {
+        size_t count = std::min<size_t>(SFS_ADPCM_SAMPLES_PER_BLOCK, pCount - first);
+        u8    *block = pDst;
+        s32    pred  = pSrc[first];
+
+        memset(block, 0, BLOCK_SIZE);
+        memcpy(block, &pSrc[first], sizeof(s16));
+        block[2] = index;
+
+        pError.signalSquares += (f64) pred * pred;
+
+        for (size_t i = 1; i < count; i++)
+        {
+            s32 sample = pSrc[first + i];
+            s32 diff   = sample - pred;
+            s32 step   = adpcmStepTable[index];
+            u8  code   = 0;
+
+            if (diff < 0)
+            {
+                code = 8;
+                diff = -diff;
+            }
+
+            if (diff >= step)
+            {
+                code |= 4;
+                diff -= step;
+            }
+
+            if (diff >= step >> 1)
+            {
+                code |= 2;
+                diff -= step >> 1;
+            }
+
+            if (diff >= step >> 2)
+            {
+                code |= 1;
+            }
+
+            adpcmStep(code, pred, index);
+
+            block[SFS_ADPCM_HEADER_SIZE + (i - 1) / 2] |= (i - 1) & 1 ? code << 4 : code;
+
+            s32 error = sample - pred;
+            pError.signalSquares += (f64) sample * sample;
+            pError.errorSquares += (f64) error * error;
+            pError.peak = std::max<u32>(pError.peak, std::abs(error));
+        }
+
+        pError.count += count;
+        pDst += BLOCK_SIZE;
+    }
+
+    pStepIndex = index;
+}
+
+void adpcmDecodeBlockScalar(const u8 *pBlock, s16 *pDst, size_t pCount) {
+    if (pCount == 0)
+    {
+        return;
+    }
+
+    s16 first;
+    memcpy(&first, pBlock, sizeof(s16));
+
+    s32 pred  = first;
+    s32 index = std::min<s32>(pBlock[2], ADPCM_STEP_COUNT - 1);
+
+    pDst[0] = first;
+    for (size_t i = 1; i < pCount; i++)
+    {
+        u8 byte = pBlock[SFS_ADPCM_HEADER_SIZE + (i - 1) / 2];
+        adpcmStep((i - 1) & 1 ? byte >> 4 : byte & 0xF, pred, index);
+
+        pDst[i] = pred;
+    }
+}
+
+#ifdef ADPCM_X86_SIMD
+
+// decodes 8 consecutive whole blocks, one per lane. codes are gathered a dword (8 codes) at a time, and every 4 steps
+// the 8 lanes x 4 samples are transposed so each block's samples are stored contiguously.
+__attribute__((target("avx2")))
+static void adpcmDecode8Avx2(const u8 *pSrc, s16 *pDst) {
+    const __m256i lanes    = _mm256_mullo_epi32(_mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7), _mm256_set1_epi32(BLOCK_SIZE / 4));
+    const __m256i nibble   = _mm256_set1_epi32(0xF);
+    const __m256i bit1     = _mm256_set1_epi32(1);
+    const __m256i bit2     = _mm256_set1_epi32(2);
+    const __m256i bit4     = _mm256_set1_epi32(4);
+    const __m256i bit8     = _mm256_set1_epi32(8);
+    const __m256i minus1   = _mm256_set1_epi32(-1);
+    const __m256i predMin  = _mm256_set1_epi32(-32768);
+    const __m256i predMax  = _mm256_set1_epi32(32767);
+    const __m256i indexMax = _mm256_set1_epi32(ADPCM_STEP_COUNT - 1);
+
+    __m256i header = _mm256_i32gather_epi32((const int *) pSrc, lanes, 4);
+    __m256i pred   = _mm256_srai_epi32(_mm256_slli_epi32(header, 16), 16);
+    __m256i index  = _mm256_min_epi32(_mm256_and_si256(_mm256_srli_epi32(header, 16), _mm256_set1_epi32(0xFF)), indexMax);
+
+    for (int l = 0; l < 8; l++)
+    {
+        memcpy(pDst + l * SFS_ADPCM_SAMPLES_PER_BLOCK, pSrc + l * BLOCK_SIZE, sizeof(s16));
+    }
+
+    constexpr int codeWords = (BLOCK_SIZE - SFS_ADPCM_HEADER_SIZE) / 4;
+    for (int g = 0; g < codeWords; g++)
+    {
+        __m256i codes = _mm256_i32gather_epi32((const int *) pSrc, _mm256_add_epi32(lanes, _mm256_set1_epi32(1 + g)), 4);
+
+        for (int h = 0; h < 2; h++)
+        {
+            __m256i v[4];
+            for (int j = 0; j < 4; j++)
+            {
+                __m256i code = _mm256_and_si256(codes, nibble);
+                codes        = _mm256_srli_epi32(codes, 4);
+
+                __m256i step = _mm256_i32gather_epi32(adpcmStepTable, index, 4);
+                __m256i m1   = _mm256_cmpeq_epi32(_mm256_and_si256(code, bit1), bit1);
+                __m256i m2   = _mm256_cmpeq_epi32(_mm256_and_si256(code, bit2), bit2);
+                __m256i m4   = _mm256_cmpeq_epi32(_mm256_and_si256(code, bit4), bit4);
+                __m256i m8   = _mm256_cmpeq_epi32(_mm256_and_si256(code, bit8), bit8);
+
+                __m256i diff = _mm256_srli_epi32(step, 3);
+                diff         = _mm256_add_epi32(diff, _mm256_and_si256(step, m4));
+                diff         = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_srli_epi32(step, 1), m2));
+                diff         = _mm256_add_epi32(diff, _mm256_and_si256(_mm256_srli_epi32(step, 2), m1));
+
+                // m8 is all ones for negative codes, (diff ^ -1) - -1 == -diff
+                pred = _mm256_add_epi32(pred, _mm256_sub_epi32(_mm256_xor_si256(diff, m8), m8));
+                pred = _mm256_min_epi32(_mm256_max_epi32(pred, predMin), predMax);
+
+                __m256i up = _mm256_slli_epi32(_mm256_add_epi32(_mm256_and_si256(code, _mm256_set1_epi32(3)), bit1), 1);
+                index      = _mm256_add_epi32(index, _mm256_blendv_epi8(minus1, up, m4));
+                index      = _mm256_min_epi32(_mm256_max_epi32(index, _mm256_setzero_si256()), indexMax);
+
+                v[j] = pred;
+            }
+
+            // 4x4 transpose inside each 128 bit half, r[k] holds lane k's 4 samples low and lane k + 4's high
+            __m256i t0 = _mm256_unpacklo_epi32(v[0], v[1]);
+            __m256i t1 = _mm256_unpacklo_epi32(v[2], v[3]);
+            __m256i t2 = _mm256_unpackhi_epi32(v[0], v[1]);
+            __m256i t3 = _mm256_unpackhi_epi32(v[2], v[3]);
+
+            __m256i p01 = _mm256_packs_epi32(_mm256_unpacklo_epi64(t0, t1), _mm256_unpackhi_epi64(t0, t1));
+            __m256i p23 = _mm256_packs_epi32(_mm256_unpacklo_epi64(t2, t3), _mm256_unpackhi_epi64(t2, t3));
+
+            s16 *dst = pDst + 1 + g * 8 + h * 4;
+
+            __m128i lo01 = _mm256_castsi256_si128(p01), hi01 = _mm256_extracti128_si256(p01, 1);
+            __m128i lo23 = _mm256_castsi256_si128(p23), hi23 = _mm256_extracti128_si256(p23, 1);
+
+            _mm_storel_epi64((__m128i *) (dst + 0 * SFS_ADPCM_SAMPLES_PER_BLOCK), lo01);
+            _mm_storeh_pd((double *) (dst + 1 * SFS_ADPCM_SAMPLES_PER_BLOCK), _mm_castsi128_pd(lo01));
+            _mm_storel_epi64((__m128i *) (dst + 2 * SFS_ADPCM_SAMPLES_PER_BLOCK), lo23);
+            _mm_storeh_pd((double *) (dst + 3 * SFS_ADPCM_SAMPLES_PER_BLOCK), _mm_castsi128_pd(lo23));
+            _mm_storel_epi64((__m128i *) (dst + 4 * SFS_ADPCM_SAMPLES_PER_BLOCK), hi01);
+            _mm_storeh_pd((double *) (dst + 5 * SFS_ADPCM_SAMPLES_PER_BLOCK), _mm_castsi128_pd(hi01));
+            _mm_storel_epi64((__m128i *) (dst + 6 * SFS_ADPCM_SAMPLES_PER_BLOCK), hi23);
+            _mm_storeh_pd((double *) (dst + 7 * SFS_ADPCM_SAMPLES_PER_BLOCK), _mm_castsi128_pd(hi23));
+        }
+    }
+}
+
+#endif
+
+void adpcmDecode(const u8 *pSrc, s16 *pDst, size_t pCount) {
+    size_t blocks = adpcmBlocksFor(pCount);
+    size_t full   = pCount / SFS_ADPCM_SAMPLES_PER_BLOCK;
+    size_t b      = 0;
+
+    #ifdef ADPCM_X86_SIMD
+    if (adpcmHasSimd())
+    {
+        for (; b + 8 <= full; b += 8)
+        {
+            adpcmDecode8Avx2(pSrc + b * BLOCK_SIZE, pDst + b * SFS_ADPCM_SAMPLES_PER_BLOCK);
+        }
+    }
+    #endif
+
+    for (; b < blocks; b++)
+    {
+        size_t first = b * SFS_ADPCM_SAMPLES_PER_BLOCK;
+        adpcmDecodeBlockScalar(pSrc + b * BLOCK_SIZE, pDst + first, std::min<size_t>(SFS_ADPCM_SAMPLES_PER_BLOCK, pCount - first));
+    }
+}
+
+bool adpcmHasSimd() {
+    #ifdef ADPCM_X86_SIMD
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+    #else
+    return false;
+    #endif
+}
@@ -0,0 +1,47 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef ADPCM_H
+#define ADPCM_H
+
+#include <cstddef>
+
+#include "types.h"
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+#define ADPCM_STEP_COUNT 89
+
+// squared error of the decoded signal against the source, combines by adding (and taking the larger peak)
+struct AdpcmError {
+    u64 count;
+    f64 signalSquares;
+    f64 errorSquares;
+    u32 peak; // largest |decoded - source|
+
+    // signal to noise ratio in dB, infinite when the encoding was exact
+    f64 snr() const;
+};
+
+// blocks taken by pCount samples, see SFS_ADPCM_SAMPLES_PER_BLOCK
+u32 adpcmBlocksFor(size_t pCount);
+
+// encodes pCount samples into adpcmBlocksFor(pCount) whole blocks at pDst. pStepIndex carries the quantizer state
+// from one call to the next (start it at 0), so a sample can be encoded in chunks of whole blocks. pError gets the
+// error of what a decoder will reproduce.
+void adpcmEncode(const s16 *pSrc, size_t pCount, u8 *pDst, u8 &pStepIndex, AdpcmError &pError);
+
+// reference kernel, decodes the first pCount (<= SFS_ADPCM_SAMPLES_PER_BLOCK) samples of one block
+void adpcmDecodeBlockScalar(const u8 *pBlock, s16 *pDst, size_t pCount);
+
+// decodes pCount samples from the blocks at pSrc. blocks are independent, so 8 of them are decoded side by side in
+// avx2 lanes where the cpu allows it. produces the same output as adpcmDecodeBlockScalar.
+void adpcmDecode(const u8 *pSrc, s16 *pDst, size_t pCount);
+
+bool adpcmHasSimd();
+
+#endif //ADPCM_H
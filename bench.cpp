@@ -0,0 +1,446 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "bench.h"
+
+#include "adpcm.h"
+#include "lossless.h"
+#include "mapped_file.h"
+#include "pcm.h"
+#include "riff_reader.h"
+
+extern "C" {
+#include <wav/wav.h>
+}
+
+// fill shifts every source to its neighbours, at most 6 semitones either way
+#define BENCH_FILL_MAX_SHIFT 6
+#define BENCH_GENERATED_SOURCES 8
+#define BENCH_GENERATED_LENGTH (WAV_SAMPLE_RATE * 6)
+
+static f64 benchSeconds(const std::function<void()> &pFn, size_t pIterations) {
+    f64 best = 1e30;
+
+    for (size_t i = 0; i < pIterations; ++i)
+    {
+        auto t0 = std::chrono::steady_clock::now();
+        pFn();
+        auto t1 = std::chrono::steady_clock::now();
+
+        best = std::min(best, std::chrono::duration<f64>(t1 - t0).count());
+    }
+
+    return best;
+}
+
+static void benchReport(const char *pName, size_t pBytes, f64 pSeconds) {
+    printf("\t- %-24s %8.2f ms  %9.1f MiB/s\n", pName, pSeconds * 1000.0, (f64) pBytes / pSeconds / (1024.0 * 1024.0));
+}
+
+// the wavs of an instrument folder, or generated pcm when there is none
+struct BenchSources {
+    std::vector<MappedFile>                      files;
+    std::vector<std::vector<s16> >               generated;
+    std::vector<std::pair<const s16 *, size_t> > samples;
+};
+
+static bool benchLoadSources(const std::filesystem::path &pInstrumentFolder, BenchSources &pSources) {
+    if (!pInstrumentFolder.empty())
+    {
+        for (const auto &ent: std::filesystem::directory_iterator(pInstrumentFolder))
+        {
+            if (ent.path().extension() != ".wav")
+            {
+                continue;
+            }
+
+            MappedFile  file(ent.path());
+            RiffWavInfo info;
+            if (!file.isOpen() || RiffReader::parse(file.data(), file.size(), info) != SERR_OK || info.dataOffset % 2 != 0)
+            {
+                continue;
+            }
+
+            pSources.samples.emplace_back(file.at<s16>(info.dataOffset), info.dataSize / sizeof(s16));
+            pSources.files.push_back(std::move(file));
+        }
+    }
+    else
+    {
+        // decaying partials plus a little noise, close enough to a real sample for the kernels
+        u32 seed = 0x1234567;
+        for (int i = 0; i < BENCH_GENERATED_SOURCES; ++i)
+        {
+            std::vector<s16> pcm(BENCH_GENERATED_LENGTH);
+            f64              freq = 55.0 * pcmSemitoneRatio(i * 7);
+
+            for (size_t j = 0; j < pcm.size(); ++j)
+            {
+                seed = seed * 1664525 + 1013904223;
+
+                f64 t = (f64) j / WAV_SAMPLE_RATE;
+                f64 x = std::sin(2 * M_PI * freq * t) * 0.6 + std::sin(4 * M_PI * freq * t) * 0.2;
+                x     = x * std::exp(-t * 0.5) + ((s32) (seed >> 16) - 0x8000) / 32768.0 * 0.02;
+
+                pcm[j] = (s16) (x * 32767.0);
+            }
+
+            pSources.generated.push_back(std::move(pcm));
+        }
+
+        for (const auto &pcm: pSources.generated)
+        {
+            pSources.samples.emplace_back(pcm.data(), pcm.size());
+        }
+    }
+
+    if (pSources.samples.empty())
+    {
+        printf("No samples found in %s.\n", pInstrumentFolder.generic_string().c_str());
+        return false;
+    }
+
+    return true;
+}
+
+
+synthErrno Bench::fill(const std::filesystem::path &pInstrumentFolder, size_t pIterations) {
+    BenchSources loaded;
+    if (!benchLoadSources(pInstrumentFolder, loaded))
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    const auto &sources = loaded.samples;
+
+    size_t srcBytes = 0;
+    size_t dstBytes = 0;
+    size_t maxDst   = 0;
+    for (const auto &[samples, count]: sources)
+    {
+        srcBytes += count * sizeof(s16);
+        for (int shift = -BENCH_FILL_MAX_SHIFT; shift <= BENCH_FILL_MAX_SHIFT; ++shift)
+        {
+            if (shift == 0)
+            {
+                continue;
+            }
+
+            auto len = pcmPitchShiftLength(count, shift);
+            dstBytes += len * sizeof(s16);
+            maxDst = std::max(maxDst, len);
+        }
+    }
+
+    printf("Fill benchmark: %zu sources (%.1f MiB), shifts -%d..+%d, %.1f MiB written per pass, best of %zu.\n",
+           sources.size(), srcBytes / (1024.0 * 1024.0), BENCH_FILL_MAX_SHIFT, BENCH_FILL_MAX_SHIFT, dstBytes / (1024.0 * 1024.0),
+           pIterations);
+
+    std::vector<s16> dst(maxDst);
+    std::vector<s16> ref(maxDst);
+
+    auto runAll = [&](const std::function<void(const s16 *, size_t, s16 *, size_t)> &pKernel) {
+        for (const auto &[samples, count]: sources)
+        {
+            for (int shift = -BENCH_FILL_MAX_SHIFT; shift <= BENCH_FILL_MAX_SHIFT; ++shift)
+            {
+                if (shift == 0)
+                {
+                    continue;
+                }
+
+                pKernel(samples, count, dst.data(), pcmPitchShiftLength(count, shift));
+            }
+        }
+    };
+
+    // same traffic as the kernels without any math, the ceiling fill can hope for
+    f64 copySeconds = benchSeconds([&] {
+        runAll([](const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount) {
+            for (size_t off = 0; off < pDstCount; off += pSrcCount)
+            {
+                memcpy(pDst + off, pSrc, std::min(pSrcCount, pDstCount - off) * sizeof(s16));
+            }
+        });
+    }, pIterations);
+
+    f64 scalarSeconds = benchSeconds([&] {
+        runAll(pcmPitchShiftLinearScalar);
+    }, pIterations);
+
+    f64 linearSeconds = benchSeconds([&] {
+        runAll([](const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount) {
+            pcmPitchShift(pSrc, pSrcCount, pDst, pDstCount, PCM_INTERPOLATION_LINEAR);
+        });
+    }, pIterations);
+
+    f64 cubicSeconds = benchSeconds([&] {
+        runAll([](const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount) {
+            pcmPitchShift(pSrc, pSrcCount, pDst, pDstCount, PCM_INTERPOLATION_CUBIC);
+        });
+    }, pIterations);
+
+    // what virtual fill costs the device instead: the same shifts rendered voice-style, one position per sample
+    f64 playbackSeconds = benchSeconds([&] {
+        runAll([](const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount) {
+            u64 pos = 0;
+            pcmPlaybackRender(pSrc, pSrcCount, pcmPlaybackStep(0) * pSrcCount / pDstCount, pos, pDst, pDstCount, 0, 0);
+        });
+    }, pIterations);
+
+    benchReport("memcpy (bandwidth)", dstBytes, copySeconds);
+    benchReport("linear scalar", dstBytes, scalarSeconds);
+    benchReport(pcmPitchShiftHasSimd() ? "linear avx2" : "linear (no simd)", dstBytes, linearSeconds);
+    benchReport("cubic", dstBytes, cubicSeconds);
+    benchReport("virtual playback", dstBytes, playbackSeconds);
+
+    // the vector kernel has to match the scalar reference bit for bit
+    size_t mismatches = 0;
+    for (const auto &[samples, count]: sources)
+    {
+        for (int shift = -BENCH_FILL_MAX_SHIFT; shift <= BENCH_FILL_MAX_SHIFT; ++shift)
+        {
+            auto len = pcmPitchShiftLength(count, shift);
+            pcmPitchShiftLinearScalar(samples, count, ref.data(), len);
+            pcmPitchShift(samples, count, dst.data(), len, PCM_INTERPOLATION_LINEAR);
+
+            if (memcmp(ref.data(), dst.data(), len * sizeof(s16)) != 0)
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    if (mismatches)
+    {
+        printf("\t- %zu shifts differ between the scalar and vector kernels!\n", mismatches);
+        return SERR_GENERIC_ERROR;
+    }
+
+    return SERR_OK;
+}
+
+synthErrno Bench::analyze(const std::filesystem::path &pInstrumentFolder, size_t pIterations) {
+    BenchSources loaded;
+    if (!benchLoadSources(pInstrumentFolder, loaded))
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    size_t bytes = 0;
+    for (const auto &[samples, count]: loaded.samples)
+    {
+        bytes += count * sizeof(s16);
+    }
+
+    printf("Analysis benchmark: %zu sources (%.1f MiB), best of %zu.\n", loaded.samples.size(), bytes / (1024.0 * 1024.0), pIterations);
+
+    PcmStats sink = {};
+
+    f64 scalarSeconds = benchSeconds([&] {
+        for (const auto &[samples, count]: loaded.samples)
+        {
+            pcmAnalyzeScalar(samples, count, sink);
+        }
+    }, pIterations);
+
+    f64 vectorSeconds = benchSeconds([&] {
+        for (const auto &[samples, count]: loaded.samples)
+        {
+            pcmAnalyze(samples, count, sink);
+        }
+    }, pIterations);
+
+    benchReport("analysis scalar", bytes, scalarSeconds);
+    benchReport(pcmPitchShiftHasSimd() ? "analysis avx2" : "analysis (no simd)", bytes, vectorSeconds);
+
+    // every sum has to match the scalar reference exactly, odd lengths exercise the scalar tail
+    size_t mismatches = 0;
+    for (const auto &[samples, count]: loaded.samples)
+    {
+        for (size_t len: {count, count - count / 3})
+        {
+            PcmStats ref = {}, vec = {};
+            pcmAnalyzeScalar(samples, len, ref);
+            pcmAnalyze(samples, len, vec);
+
+            if (ref.count != vec.count || ref.sumAbs != vec.sumAbs || ref.sumSquares != vec.sumSquares || ref.sum != vec.sum ||
+                ref.peak != vec.peak)
+            {
+                mismatches++;
+            }
+        }
+    }
+
+    if (mismatches)
+    {
+        printf("\t- %zu sources differ between the scalar and vector kernels!\n", mismatches);
+        return SERR_GENERIC_ERROR;
+    }
+
+    return SERR_OK;
+}
+
+synthErrno Bench::adpcm(const std::filesystem::path &pInstrumentFolder, size_t pIterations) {
+    BenchSources loaded;
+    if (!benchLoadSources(pInstrumentFolder, loaded))
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    size_t bytes = 0;
+    for (const auto &[samples, count]: loaded.samples)
+    {
+        bytes += count * sizeof(s16);
+    }
+
+    printf("ADPCM benchmark: %zu sources (%.1f MiB), best of %zu.\n", loaded.samples.size(), bytes / (1024.0 * 1024.0), pIterations);
+
+    std::vector<std::vector<u8> > encoded(loaded.samples.size());
+    std::vector<std::vector<s16> > decoded(loaded.samples.size());
+    AdpcmError                     error = {};
+
+    f64 encodeSeconds = benchSeconds([&] {
+        error = {};
+        for (size_t i = 0; i < loaded.samples.size(); i++)
+        {
+            const auto &[samples, count] = loaded.samples[i];
+
+            u8 index = 0;
+            encoded[i].resize((size_t) adpcmBlocksFor(count) * BLOCK_SIZE);
+            adpcmEncode(samples, count, encoded[i].data(), index, error);
+        }
+    }, pIterations);
+
+    f64 scalarSeconds = benchSeconds([&] {
+        for (size_t i = 0; i < loaded.samples.size(); i++)
+        {
+            size_t count = loaded.samples[i].second;
+            decoded[i].resize(count);
+
+            for (size_t first = 0; first < count; first += SFS_ADPCM_SAMPLES_PER_BLOCK)
+            {
+                adpcmDecodeBlockScalar(encoded[i].data() + first / SFS_ADPCM_SAMPLES_PER_BLOCK * BLOCK_SIZE, decoded[i].data() + first,
+                                       std::min<size_t>(SFS_ADPCM_SAMPLES_PER_BLOCK, count - first));
+            }
+        }
+    }, pIterations);
+
+    std::vector<std::vector<s16> > reference = decoded;
+
+    f64 vectorSeconds = benchSeconds([&] {
+        for (size_t i = 0; i < loaded.samples.size(); i++)
+        {
+            adpcmDecode(encoded[i].data(), decoded[i].data(), decoded[i].size());
+        }
+    }, pIterations);
+
+    benchReport("adpcm encode", bytes, encodeSeconds);
+    benchReport("adpcm decode scalar", bytes, scalarSeconds);
+    benchReport(adpcmHasSimd() ? "adpcm decode avx2" : "adpcm decode (no simd)", bytes, vectorSeconds);
+    printf("\t- SNR %.1f dB, peak error %u\n", error.snr(), error.peak);
+
+    if (decoded != reference)
+    {
+        printf("\t- the scalar and vector decoders differ!\n");
+        return SERR_GENERIC_ERROR;
+    }
+
+    return SERR_OK;
+}
+
+synthErrno Bench::lossless(const std::filesystem::path &pInstrumentFolder, size_t pIterations) {
+    BenchSources loaded;
+    if (!benchLoadSources(pInstrumentFolder, loaded))
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    size_t bytes = 0;
+    for (const auto &[samples, count]: loaded.samples)
+    {
+        bytes += count * sizeof(s16);
+    }
+
+    printf("Lossless benchmark: %zu sources (%.1f MiB), one thread, best of %zu.\n", loaded.samples.size(), bytes / (1024.0 * 1024.0),
+           pIterations);
+
+    std::vector<std::vector<u8> > encoded(loaded.samples.size());
+    std::vector<std::vector<s16> > decoded(loaded.samples.size());
+
+    f64 encodeSeconds = benchSeconds([&] {
+        for (size_t i = 0; i < loaded.samples.size(); i++)
+        {
+            losslessEncode(loaded.samples[i].first, loaded.samples[i].second, encoded[i]);
+        }
+    }, pIterations);
+
+    bool valid = true;
+
+    f64 decodeSeconds = benchSeconds([&] {
+        for (size_t i = 0; i < loaded.samples.size(); i++)
+        {
+            decoded[i].resize(loaded.samples[i].second);
+            valid &= losslessDecode(encoded[i].data(), encoded[i].size(), decoded[i].data(), decoded[i].size());
+        }
+    }, pIterations);
+
+    size_t stored = 0, raw = 0;
+    for (size_t i = 0; i < loaded.samples.size(); i++)
+    {
+        const auto &[samples, count] = loaded.samples[i];
+
+        raw += roundToBlock(count * sizeof(s16));
+        stored += encoded[i].size();
+        valid &= memcmp(decoded[i].data(), samples, count * sizeof(s16)) == 0;
+    }
+
+    benchReport("lossless encode", bytes, encodeSeconds);
+    benchReport("lossless decode", bytes, decodeSeconds);
+    printf("\t- stored in %.1f%% of the raw blocks\n", raw ? 100.0 * stored / raw : 0.0);
+
+    if (!valid)
+    {
+        printf("\t- the decoded samples differ from the source!\n");
+        return SERR_GENERIC_ERROR;
+    }
+
+    return SERR_OK;
+}
+
+synthErrno Bench::run(const std::string &pWorkload, const std::filesystem::path &pInstrumentFolder, size_t pIterations) {
+    if (pIterations == 0)
+    {
+        pIterations = 1;
+    }
+
+    if (pWorkload == "fill")
+    {
+        return fill(pInstrumentFolder, pIterations);
+    }
+
+    if (pWorkload == "analyze")
+    {
+        return analyze(pInstrumentFolder, pIterations);
+    }
+
+    if (pWorkload == "adpcm")
+    {
+        return adpcm(pInstrumentFolder, pIterations);
+    }
+
+    if (pWorkload == "lossless")
+    {
+        return lossless(pInstrumentFolder, pIterations);
+    }
+
+    return SERR_CMD_INVALID_ARGUMENT;
+}
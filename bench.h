@@ -0,0 +1,26 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <filesystem>
+#include <string>
+
+#include "serrno.h"
+
+class Bench {
+private:
+    static synthErrno fill(const std::filesystem::path &pInstrumentFolder, size_t pIterations);
+    static synthErrno analyze(const std::filesystem::path &pInstrumentFolder, size_t pIterations);
+    static synthErrno adpcm(const std::filesystem::path &pInstrumentFolder, size_t pIterations);
+    static synthErrno lossless(const std::filesystem::path &pInstrumentFolder, size_t pIterations);
+
+public:
+    // pInstrumentFolder may be empty, workloads then run on generated data
+    static synthErrno run(const std::string &pWorkload, const std::filesystem::path &pInstrumentFolder, size_t pIterations);
+};
+
+#endif //BENCH_H
@@ -0,0 +1,350 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "block_cache.h"
+
+#include <algorithm>
+#include <cstring>
+
+#include "pcm_layout.h"
+
+BlockCache::BlockCache(blockCachePolicy pPolicy, u32 pCapacityBlocks, BlockCacheBackend pBackend) {
+    policy   = pPolicy;
+    capacity = pCapacityBlocks;
+    backend  = std::move(pBackend);
+
+    slots.resize((size_t) capacity * BLOCK_SIZE);
+    clear();
+}
+
+void BlockCache::clear() {
+    slotBlock.assign(capacity, 0);
+    referenced.assign(capacity, false);
+
+    // popped from the back, so slots fill in ascending order
+    freeSlots.resize(capacity);
+    for (u32 i = 0; i < capacity; i++)
+    {
+        freeSlots[i] = capacity - 1 - i;
+    }
+
+    entries.clear();
+    for (auto &list: lists)
+    {
+        list.clear();
+    }
+
+    hand      = 0;
+    arcTarget = 0;
+    stats     = {};
+}
+
+void BlockCache::moveTo(u32 pBlock, Entry &pEntry, List pList) {
+    lists[pEntry.list].erase(pEntry.it);
+    lists[pList].push_front(pBlock);
+
+    pEntry.list = pList;
+    pEntry.it   = lists[pList].begin();
+}
+
+void BlockCache::forget(List pList) {
+    entries.erase(lists[pList].back());
+    lists[pList].pop_back();
+}
+
+u32 BlockCache::evictClock() {
+    // blocks read again since the hand last passed get one more round
+    while (referenced[hand])
+    {
+        referenced[hand] = false;
+        hand             = (hand + 1) % capacity;
+    }
+
+    u32 slot = hand;
+    hand     = (hand + 1) % capacity;
+
+    entries.erase(slotBlock[slot]);
+    stats.evictions++;
+
+    return slot;
+}
+
+u32 BlockCache::evictArc(bool pInB2) {
+    size_t t1 = lists[ARC_T1].size();
+
+    List from = ARC_T2, to = ARC_B2;
+    if (lists[ARC_T2].empty() || (t1 >= 1 && (t1 > arcTarget || (pInB2 && t1 == arcTarget))))
+    {
+        from = ARC_T1;
+        to   = ARC_B1;
+    }
+
+    u32   victim = lists[from].back();
+    auto &entry  = entries[victim];
+    u32   slot   = entry.slot;
+
+    entry.slot = BLOCK_CACHE_GHOST;
+    moveTo(victim, entry, to);
+
+    stats.evictions++;
+    return slot;
+}
+
+u32 BlockCache::slotFor(u32 pBlock, bool &pHit) {
+    auto found = entries.find(pBlock);
+
+    pHit = found != entries.end() && found->second.slot != BLOCK_CACHE_GHOST;
+
+    auto takeFree = [&]() {
+        u32 slot = freeSlots.back();
+        freeSlots.pop_back();
+        return slot;
+    };
+
+    u32 slot = 0;
+    switch (policy)
+    {
+        case BLOCK_CACHE_LRU:
+        {
+            if (pHit)
+            {
+                moveTo(pBlock, found->second, ARC_T1);
+                return found->second.slot;
+            }
+
+            if (!freeSlots.empty())
+            {
+                slot = takeFree();
+            }
+            else
+            {
+                slot = entries[lists[ARC_T1].back()].slot;
+                forget(ARC_T1);
+                stats.evictions++;
+            }
+
+            lists[ARC_T1].push_front(pBlock);
+            entries[pBlock] = {slot, ARC_T1, lists[ARC_T1].begin()};
+            break;
+        }
+
+        case BLOCK_CACHE_CLOCK:
+        {
+            if (pHit)
+            {
+                referenced[found->second.slot] = true;
+                return found->second.slot;
+            }
+
+            // a block has to be read again to earn its second chance, so one pass over many attacks does not
+            // push out the blocks that keep coming back
+            slot             = freeSlots.empty() ? evictClock() : takeFree();
+            referenced[slot] = false;
+
+            entries[pBlock] = {slot, ARC_T1, {}};
+            break;
+        }
+
+        case BLOCK_CACHE_ARC:
+        {
+            if (pHit)
+            {
+                moveTo(pBlock, found->second, ARC_T2);
+                return found->second.slot;
+            }
+
+            size_t b1 = lists[ARC_B1].size(), b2 = lists[ARC_B2].size();
+
+            if (found != entries.end())
+            {
+                // a ghost hit means the list it was evicted from was too short, grow that side's target
+                bool inB2 = found->second.list == ARC_B2;
+                if (inB2)
+                {
+                    arcTarget = std::max(0.0, arcTarget - std::max(1.0, (f64) b1 / b2));
+                }
+                else
+                {
+                    arcTarget = std::min((f64) capacity, arcTarget + std::max(1.0, (f64) b2 / b1));
+                }
+
+                slot                = freeSlots.empty() ? evictArc(inB2) : takeFree();
+                found->second.slot  = slot;
+                moveTo(pBlock, found->second, ARC_T2);
+                break;
+            }
+
+            size_t t1 = lists[ARC_T1].size(), t2 = lists[ARC_T2].size();
+            if (t1 + b1 == capacity)
+            {
+                if (t1 < capacity)
+                {
+                    forget(ARC_B1);
+                    slot = freeSlots.empty() ? evictArc(false) : takeFree();
+                }
+                else
+                {
+                    slot = entries[lists[ARC_T1].back()].slot;
+                    forget(ARC_T1);
+                    stats.evictions++;
+                }
+            }
+            else
+            {
+                if (t1 + t2 + b1 + b2 >= 2 * (size_t) capacity)
+                {
+                    forget(ARC_B2);
+                }
+
+                slot = freeSlots.empty() ? evictArc(false) : takeFree();
+            }
+
+            lists[ARC_T1].push_front(pBlock);
+            entries[pBlock] = {slot, ARC_T1, lists[ARC_T1].begin()};
+            break;
+        }
+    }
+
+    slotBlock[slot] = pBlock;
+    return slot;
+}
+
+synthErrno BlockCache::read(u8 *pData, u32 pBlkIdx, u32 pBlkCnt, u32 pByteOffset, u32 pByteCount) {
+    if (pBlkCnt == 0)
+    {
+        return SERR_SD_GENERIC_ERROR;
+    }
+
+    u64 start = (u64) pBlkIdx * BLOCK_SIZE + pByteOffset;
+    u64 len   = (u64) (pBlkCnt - 1) * BLOCK_SIZE + pByteCount;
+    if (len == 0)
+    {
+        return SERR_OK;
+    }
+
+    u32 first = start / BLOCK_SIZE;
+    u32 last  = (start + len - 1) / BLOCK_SIZE;
+
+    // the part of block pBlock that belongs in pData
+    auto copyOut = [&](u32 pBlock, const u8 *pSrc) {
+        u64 blockStart = (u64) pBlock * BLOCK_SIZE;
+        u64 from       = std::max(start, blockStart);
+        u64 to         = std::min(start + len, blockStart + BLOCK_SIZE);
+
+        memcpy(pData + (from - start), pSrc + (from - blockStart), to - from);
+    };
+
+    auto resident = [&](u32 pBlock) {
+        auto found = entries.find(pBlock);
+        return found != entries.end() && found->second.slot != BLOCK_CACHE_GHOST;
+    };
+
+    std::vector<u8> run;
+    for (u32 blk = first; blk <= last;)
+    {
+        if (capacity != 0 && resident(blk))
+        {
+            bool hit;
+            u32  slot = slotFor(blk, hit);
+
+            copyOut(blk, &slots[(size_t) slot * BLOCK_SIZE]);
+            stats.hits++;
+            blk++;
+            continue;
+        }
+
+        // every missing block up to the next resident one is fetched with one command
+        u32 runEnd = blk + 1;
+        while (runEnd <= last && !(capacity != 0 && resident(runEnd)))
+        {
+            runEnd++;
+        }
+
+        u32 runStart = blk;
+        run.resize((size_t) (runEnd - runStart) * BLOCK_SIZE);
+
+        synthErrno ret = backend(run.data(), runStart, runEnd - runStart);
+        if (ret != SERR_OK)
+        {
+            return ret;
+        }
+
+        stats.commands++;
+
+        for (; blk < runEnd; blk++)
+        {
+            const u8 *src = &run[(size_t) (blk - runStart) * BLOCK_SIZE];
+            copyOut(blk, src);
+            stats.misses++;
+
+            if (capacity != 0)
+            {
+                bool hit;
+                u32  slot = slotFor(blk, hit);
+                memcpy(&slots[(size_t) slot * BLOCK_SIZE], src, BLOCK_SIZE);
+            }
+        }
+    }
+
+    return SERR_OK;
+}
+
+synthErrno BlockCache::replay(const SfsImage &pImage, const std::vector<MidiNoteOn> &pNotes, int pInstrument, u32 pAttackBlocks) {
+    auto tables  = pImage.proximityTables();
+    auto samples = pImage.samples();
+
+    std::vector<u8> voice((size_t) pAttackBlocks * BLOCK_SIZE);
+
+    sfsMountImage(&pImage);
+    sfsMountCache(this);
+
+    synthErrno ret = SERR_OK;
+    for (const auto &note: pNotes)
+    {
+        size_t instrument = pInstrument < 0 ? note.channel : pInstrument;
+        u32    sampleIdx  = instrument < tables.size() ? PcmLayout::resolveSample(tables[instrument], note.key, note.velocity) : PCM_LAYOUT_NO_SAMPLE;
+        if (sampleIdx >= samples.size())
+        {
+            continue;
+        }
+
+        const auto &sample = samples[sampleIdx];
+        u32         blocks = std::min<u32>(pAttackBlocks, sfsSampleBlockCount(sample));
+        if (blocks == 0)
+        {
+            continue;
+        }
+
+        ret = sfsReadBlocksFull(voice.data(), sample.pcmDataBlockOffset, blocks);
+        if (ret != SERR_OK)
+        {
+            break;
+        }
+    }
+
+    sfsMountCache(nullptr);
+    sfsMountImage(nullptr);
+
+    return ret;
+}
+
+bool BlockCache::parsePolicy(const std::string &pName, blockCachePolicy &pPolicy) {
+    static const std::pair<const char *, blockCachePolicy> names[] = {
+        {"lru", BLOCK_CACHE_LRU},
+        {"clock", BLOCK_CACHE_CLOCK},
+        {"arc", BLOCK_CACHE_ARC},
+    };
+
+    for (const auto &[name, policy]: names)
+    {
+        if (pName == name)
+        {
+            pPolicy = policy;
+            return true;
+        }
+    }
+
+    return false;
+}
@@ -0,0 +1,98 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef BLOCK_CACHE_H
+#define BLOCK_CACHE_H
+
+#include <functional>
+#include <list>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "midi_trace.h"
+#include "sfs_image.h"
+
+typedef enum : u8 {
+    BLOCK_CACHE_LRU,   // evicts the least recently used block
+    BLOCK_CACHE_CLOCK, // second chance over a ring of slots, what a firmware can afford per read
+    BLOCK_CACHE_ARC,   // adaptive replacement, balances recency against frequency using ghost lists
+} blockCachePolicy;
+
+struct BlockCacheStats {
+    u64 hits;
+    u64 misses;
+    u64 evictions;
+    u64 commands; // backend reads, consecutive missing blocks of one read are fetched together
+};
+
+// reads the cache cannot serve, pCount whole blocks from pBlock
+using BlockCacheBackend = std::function<synthErrno(u8 *pData, u32 pBlock, u32 pCount)>;
+
+// block granular read cache with the interface of sfsReadBlocks, for sizing the firmware's cache on the host.
+// capacity is in blocks, every policy works on the same slots so their counters compare directly
+class BlockCache {
+private:
+    enum List : u8 {
+        ARC_T1, // resident, seen once (lru keeps everything here)
+        ARC_T2, // resident, seen at least twice
+        ARC_B1, // ghosts evicted from t1
+        ARC_B2, // ghosts evicted from t2
+        LIST_COUNT,
+    };
+
+    struct Entry {
+        u32                      slot; // BLOCK_CACHE_GHOST for arc ghosts
+        List                     list;
+        std::list<u32>::iterator it;
+    };
+
+    blockCachePolicy  policy;
+    u32               capacity;
+    BlockCacheBackend backend;
+
+    std::vector<u8>   slots;     // capacity blocks of data
+    std::vector<u32>  slotBlock; // block held by each slot
+    std::vector<bool> referenced;
+    std::vector<u32>  freeSlots;
+    u32               hand;
+
+    std::unordered_map<u32, Entry> entries;
+    std::list<u32>                 lists[LIST_COUNT]; // most recent first
+    f64                            arcTarget;         // arc's p, the size t1 is steered towards
+
+    BlockCacheStats stats;
+
+    u32  slotFor(u32 pBlock, bool &pHit);
+    u32  evictClock();
+    u32  evictArc(bool pInB2);
+    void moveTo(u32 pBlock, Entry &pEntry, List pList);
+    void forget(List pList);
+
+public:
+    BlockCache(blockCachePolicy pPolicy, u32 pCapacityBlocks, BlockCacheBackend pBackend);
+
+    // same arguments as sfsReadBlocks: pBlkCnt - 1 whole blocks, then pByteCount bytes, from pByteOffset into pBlkIdx
+    synthErrno read(u8 *pData, u32 pBlkIdx, u32 pBlkCnt, u32 pByteOffset, u32 pByteCount);
+
+    // plays pNotes through sfsReadBlocks with this cache mounted on pImage, every voice start reading its first
+    // pAttackBlocks blocks. pInstrument as in SeekEstimateOptions
+    synthErrno replay(const SfsImage &pImage, const std::vector<MidiNoteOn> &pNotes, int pInstrument, u32 pAttackBlocks);
+
+    void clear();
+
+    const BlockCacheStats &counters() const {
+        return stats;
+    }
+
+    static bool parsePolicy(const std::string &pName, blockCachePolicy &pPolicy);
+};
+
+#define BLOCK_CACHE_GHOST 0xFFFFFFFFu
+
+// routes the host sfsReadBlocks through pCache (nullptr bypasses it), the cache's backend does the actual reads
+void sfsMountCache(BlockCache *pCache);
+
+#endif //BLOCK_CACHE_H
@@ -0,0 +1,131 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <fstream>
+
+#include "json.hpp"
+
+#include "build_metrics.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/resource.h>
+#endif
+
+BuildMetrics::BuildMetrics() {
+    open          = false;
+    buildStart    = std::chrono::steady_clock::now();
+    buildCpuStart = cpuSeconds();
+    wallStart     = buildStart;
+    cpuStart      = buildCpuStart;
+}
+
+BuildPhaseMetrics &BuildMetrics::begin(const std::string &pName) {
+    end();
+
+    BuildPhaseMetrics phase = {};
+    phase.name              = pName;
+    phases.push_back(phase);
+
+    open      = true;
+    wallStart = std::chrono::steady_clock::now();
+    cpuStart  = cpuSeconds();
+
+    return phases.back();
+}
+
+void BuildMetrics::end() {
+    if (!open)
+    {
+        return;
+    }
+
+    auto &phase       = phases.back();
+    phase.wallSeconds = std::chrono::duration<f64>(std::chrono::steady_clock::now() - wallStart).count();
+    phase.cpuSeconds  = cpuSeconds() - cpuStart;
+
+    open = false;
+}
+
+void BuildMetrics::counter(const std::string &pName, u64 pValue) {
+    counters.emplace_back(pName, pValue);
+}
+
+void BuildMetrics::sample(const BuildSampleMetrics &pSample) {
+    samples.push_back(pSample);
+}
+
+bool BuildMetrics::save(const std::filesystem::path &pFile) {
+    end();
+
+    nlohmann::ordered_json json;
+
+    json["version"]     = BUILD_METRICS_VERSION;
+    json["wallSeconds"] = std::chrono::duration<f64>(std::chrono::steady_clock::now() - buildStart).count();
+    json["cpuSeconds"]  = cpuSeconds() - buildCpuStart;
+
+    json["counters"] = nlohmann::ordered_json::object();
+    for (const auto &[name, value]: counters)
+    {
+        json["counters"][name] = value;
+    }
+
+    json["phases"] = nlohmann::ordered_json::array();
+    for (const auto &phase: phases)
+    {
+        json["phases"].push_back({
+            {"name", phase.name},
+            {"wallSeconds", phase.wallSeconds},
+            {"cpuSeconds", phase.cpuSeconds},
+            {"bytesRead", phase.bytesRead},
+            {"bytesWritten", phase.bytesWritten},
+            {"samples", phase.samples},
+            {"paddingBytes", phase.paddingBytes},
+        });
+    }
+
+    json["samples"] = nlohmann::ordered_json::array();
+    for (const auto &sample: samples)
+    {
+        json["samples"].push_back({
+            {"name", sample.name},
+            {"startMeanAbs", sample.startMeanAbs},
+            {"endMeanAbs", sample.endMeanAbs},
+            {"startRms", sample.startRms},
+            {"endRms", sample.endRms},
+            {"peak", sample.peak},
+            {"dcOffset", sample.dcOffset},
+        });
+    }
+
+    std::ofstream out(pFile);
+    out << json.dump(4);
+
+    return out.good();
+}
+
+f64 BuildMetrics::cpuSeconds() {
+    #ifdef _WIN32
+    FILETIME creation, exit, kernel, user;
+    if (!GetProcessTimes(GetCurrentProcess(), &creation, &exit, &kernel, &user))
+    {
+        return 0;
+    }
+
+    // 100 ns ticks
+    auto ticks = [](const FILETIME &pTime) {
+        return ((u64) pTime.dwHighDateTime << 32 | pTime.dwLowDateTime) * 1e-7;
+    };
+
+    return ticks(kernel) + ticks(user);
+    #else
+    rusage usage = {};
+    getrusage(RUSAGE_SELF, &usage);
+
+    return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) * 1e-6;
+    #endif
+}
@@ -0,0 +1,68 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef BUILD_METRICS_H
+#define BUILD_METRICS_H
+
+#include <chrono>
+#include <filesystem>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "types.h"
+
+#define BUILD_METRICS_VERSION 1
+
+struct BuildPhaseMetrics {
+    std::string name;
+    f64         wallSeconds;
+    f64         cpuSeconds; // whole process, so a parallel phase can exceed its wall time
+    u64         bytesRead;
+    u64         bytesWritten;
+    u64         samples;
+    u64         paddingBytes; // alignment and block rounding, written as zeros or left as a hole
+};
+
+// what was measured of one stored sample's pcm, see SampleAnalysis
+struct BuildSampleMetrics {
+    std::string name; // instrument folder and wav name
+    u16         startMeanAbs, endMeanAbs;
+    u16         startRms, endRms;
+    u16         peak;
+    s16         dcOffset;
+};
+
+// per phase timings and byte counts of one mkimg run, saved as json so builds can be compared over time.
+// phases are sequential, starting one ends the previous
+class BuildMetrics {
+private:
+    std::vector<BuildPhaseMetrics>            phases;
+    std::vector<std::pair<std::string, u64> > counters;
+    std::vector<BuildSampleMetrics>           samples;
+
+    bool                                  open;
+    std::chrono::steady_clock::time_point wallStart, buildStart;
+    f64                                   cpuStart, buildCpuStart;
+
+public:
+    BuildMetrics();
+
+    // the returned phase stays valid until the next begin, callers fill in its byte and sample counts
+    BuildPhaseMetrics &begin(const std::string &pName);
+    void               end();
+
+    // build wide numbers that belong to no single phase
+    void counter(const std::string &pName, u64 pValue);
+
+    // samples whose pcm this build wrote, an incremental build leaves out the ones it did not touch
+    void sample(const BuildSampleMetrics &pSample);
+
+    bool save(const std::filesystem::path &pFile);
+
+    static f64 cpuSeconds();
+};
+
+#endif //BUILD_METRICS_H
@@ -0,0 +1,145 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "crc32c.h"
+
+#include <cstring>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <nmmintrin.h>
+#define CRC32C_X86
+#elif defined(__aarch64__) && defined(__ARM_FEATURE_CRC32)
+#include <arm_acle.h>
+#define CRC32C_ARM
+#endif
+
+struct Crc32cTables {
+    u32 t[8][256];
+
+    Crc32cTables() {
+        for (u32 i = 0; i < 256; i++)
+        {
+            u32 crc = i;
+            for (int j = 0; j < 8; j++)
+            {
+                crc = crc & 1 ? (crc >> 1) ^ CRC32C_POLY : crc >> 1;
+            }
+
+            t[0][i] = crc;
+        }
+
+        for (u32 i = 0; i < 256; i++)
+        {
+            for (int k = 1; k < 8; k++)
+            {
+                t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+            }
+        }
+    }
+};
+
+static u32 crc32cSoftware(const u8 *pData, size_t pSize, u32 pCrc) {
+    static const Crc32cTables tables;
+    const auto               &t = tables.t;
+
+    while (pSize >= 8)
+    {
+        u32 lo, hi;
+        memcpy(&lo, pData, 4);
+        memcpy(&hi, pData + 4, 4);
+        lo ^= pCrc;
+
+        pCrc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^ t[4][lo >> 24] ^
+               t[3][hi & 0xFF] ^ t[2][(hi >> 8) & 0xFF] ^ t[1][(hi >> 16) & 0xFF] ^ t[0][hi >> 24];
+
+        pData += 8;
+        pSize -= 8;
+    }
+
+    while (pSize--)
+    {
+        pCrc = (pCrc >> 8) ^ t[0][(pCrc ^ *pData++) & 0xFF];
+    }
+
+    return pCrc;
+}
+
+#ifdef CRC32C_X86
+__attribute__((target("sse4.2"))) static u32 crc32cHardware(const u8 *pData, size_t pSize, u32 pCrc) {
+    #ifdef __x86_64__
+    u64 crc = pCrc;
+    while (pSize >= 8)
+    {
+        u64 word;
+        memcpy(&word, pData, 8);
+        crc = _mm_crc32_u64(crc, word);
+
+        pData += 8;
+        pSize -= 8;
+    }
+    pCrc = (u32) crc;
+    #endif
+
+    while (pSize >= 4)
+    {
+        u32 word;
+        memcpy(&word, pData, 4);
+        pCrc = _mm_crc32_u32(pCrc, word);
+
+        pData += 4;
+        pSize -= 4;
+    }
+
+    while (pSize--)
+    {
+        pCrc = _mm_crc32_u8(pCrc, *pData++);
+    }
+
+    return pCrc;
+}
+#elif defined(CRC32C_ARM)
+static u32 crc32cHardware(const u8 *pData, size_t pSize, u32 pCrc) {
+    while (pSize >= 8)
+    {
+        u64 word;
+        memcpy(&word, pData, 8);
+        pCrc = __crc32cd(pCrc, word);
+
+        pData += 8;
+        pSize -= 8;
+    }
+
+    while (pSize--)
+    {
+        pCrc = __crc32cb(pCrc, *pData++);
+    }
+
+    return pCrc;
+}
+#endif
+
+bool crc32cAccelerated() {
+    #ifdef CRC32C_X86
+    static const bool supported = __builtin_cpu_supports("sse4.2");
+    return supported;
+    #elif defined(CRC32C_ARM)
+    return true;
+    #else
+    return false;
+    #endif
+}
+
+u32 crc32c(const void *pData, size_t pSize, u32 pCrc) {
+    auto bytes = (const u8 *) pData;
+
+    #if defined(CRC32C_X86) || defined(CRC32C_ARM)
+    if (crc32cAccelerated())
+    {
+        return ~crc32cHardware(bytes, pSize, ~pCrc);
+    }
+    #endif
+
+    return ~crc32cSoftware(bytes, pSize, ~pCrc);
+}
@@ -0,0 +1,22 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef CRC32C_H
+#define CRC32C_H
+
+#include <cstddef>
+
+#include "types.h"
+
+#define CRC32C_POLY 0x82F63B78u // castagnoli, reflected
+
+// crc32c (the iscsi / ext4 / sd card checksum). uses the sse4.2 or armv8 crc instructions when the cpu has them and
+// slicing-by-8 tables otherwise, both give the same result. chain calls by passing the previous result as pCrc.
+u32 crc32c(const void *pData, size_t pSize, u32 pCrc = 0);
+
+// whether crc32c runs on the crc instructions
+bool crc32cAccelerated();
+
+#endif //CRC32C_H
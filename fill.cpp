@@ -8,13 +8,17 @@
 #include <fstream>
 #include <vector>
 #include <map>
+#include <set>
 #include <ranges>
 #include <cmath>
 #include <cstring>
 
 #include "json.hpp"
+#include "riff_reader.h"
+#include "thread_pool.h"
 
 extern "C" {
+#include <sfs/sfs.h>
 #include <synthinf/serrno.h>
 #include <wav/wav.h>
 }
@@ -22,7 +26,7 @@ extern "C" {
 namespace fs = std::filesystem;
 using namespace nlohmann;
 
-synthErrno Fill::fill(std::filesystem::path pDir) {
+synthErrno Fill::collectJobs(const std::filesystem::path &pDir, std::vector<FillJob> &pJobs) {
     const int FIRST_NOTE = 24;
     const int LAST_NOTE  = 84;
 
@@ -64,56 +68,235 @@ synthErrno Fill::fill(std::filesystem::path pDir) {
 
         for (auto velocity: velocityMap[closest])
         {
-            auto          srcPath = pDir / std::format("{}_{}.wav", closest, velocity);
-            std::ifstream srcFile(srcPath);
+            pJobs.push_back({i, closest, velocity, 0, 0});
+        }
+    }
+
+    return SERR_OK;
+}
 
-            auto srcLen = fs::file_size(srcPath);
-            auto srcBuf = new char[srcLen];
+synthErrno Fill::loadSource(const std::filesystem::path &pDir, int pNote, int pVelocity, FillSource &pSource) {
+    auto srcPath = pDir / std::format("{}_{}.wav", pNote, pVelocity);
+    if (!pSource.wav.open(srcPath))
+    {
+        return SERR_GENERIC_ERROR;
+    }
 
-            srcFile.read(srcBuf, srcLen);
+    RiffWavInfo info;
 
-            auto hdr            = (wavHeader *) srcBuf;
-            auto srcSampleCount = hdr->dataSize / sizeof(s16);
-            auto srcSamples     = (s16 *) (srcBuf + sizeof(wavHeader));
+    synthErrno ret = RiffReader::parse(pSource.wav.data(), pSource.wav.size(), info);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
 
-            auto factor         = std::pow(2.0, (closest - i) / 12.0);
-            auto dstSampleCount = (size_t) round(srcSampleCount * factor);
-            auto dstSamples     = new s16[dstSampleCount];
+    // the kernels index samples directly out of the mapping
+    if (info.dataSize < sizeof(s16) || info.dataOffset % alignof(s16) != 0)
+    {
+        return SERR_SFS_INVALID_WAV;
+    }
 
-            auto t    = 0.0;
-            auto step = (double) srcSampleCount / (double) (dstSampleCount - 1);
-            for (int j = 0; j < dstSampleCount; ++j)
-            {
-                auto floor = (size_t) t;
-                auto a     = srcSamples[floor];
-                auto b     = srcSamples[floor + 1];
-                auto c     = t - floor;
+    pSource.sampleCount = info.dataSize / sizeof(s16);
+    pSource.samples     = pSource.wav.at<s16>(info.dataOffset);
+
+    std::ifstream srcJsonFile(pDir / std::format("{}_{}.json", pNote, pVelocity));
+    srcJsonFile >> pSource.json;
+
+    return SERR_OK;
+}
+
+synthErrno Fill::runJob(const std::filesystem::path &pDir, const FillJob &pJob, const FillSource &pSource, const FillOptions &pOptions) {
+    auto closest  = pJob.sourceNote;
+    auto i        = pJob.note;
+    auto velocity = pJob.velocity;
+
+    auto srcSampleCount = pSource.sampleCount;
+    auto srcSamples     = pSource.samples;
+
+    auto dstSampleCount = pcmPitchShiftLength(srcSampleCount, i - closest);
+    auto dstSamples     = std::vector<s16>(dstSampleCount);
+
+    pcmPitchShift(srcSamples, srcSampleCount, dstSamples.data(), dstSampleCount, pOptions.interpolation);
+
+    auto dstPath = pDir / std::format("{}_{}.wav", i, velocity);
+    wavWriteFileDefault(dstPath.generic_string().c_str(), (u8*)dstSamples.data(), dstSampleCount * sizeof(s16));
+
+    ordered_json srcJson = pSource.json;
+
+    // used instead of the semitone ratio because of rounding errors
+    auto dstToSrcRatio = (double) dstSampleCount / (double) srcSampleCount;
 
-                auto x        = a + (b - a) * c;
-                dstSamples[j] = (s16) round(x);
+    srcJson["loopStart"]    = (int) round(srcJson["loopStart"].get<int>() * dstToSrcRatio);
+    srcJson["loopDuration"] = (int) round(srcJson["loopDuration"].get<int>() * dstToSrcRatio);
 
-                t += step;
+    std::ofstream dstJsonFile(pDir / std::format("{}_{}.json", i, velocity));
+    dstJsonFile << srcJson.dump(4);
+
+    return SERR_OK;
+}
+
+synthErrno Fill::measureJobs(const std::filesystem::path &pDir, std::vector<FillJob> &pJobs) {
+    std::map<std::pair<int, int>, size_t> sourceSampleCounts;
+
+    for (auto &job: pJobs)
+    {
+        auto key = std::pair(job.sourceNote, job.velocity);
+        if (!sourceSampleCounts.contains(key))
+        {
+            std::ifstream src(pDir / std::format("{}_{}.wav", job.sourceNote, job.velocity), std::ios_base::in | std::ios_base::binary);
+            RiffWavInfo   info;
+
+            synthErrno ret = RiffReader::parse(src, info);
+            if (ret != SERR_OK)
+            {
+                return ret;
             }
 
-            auto dstPath = pDir / std::format("{}_{}.wav", i, velocity);
-            wavWriteFileDefault(dstPath.generic_string().c_str(), (u8*)dstSamples, dstSampleCount * sizeof(s16));
+            sourceSampleCounts[key] = info.dataSize / sizeof(s16);
+        }
+
+        job.sourceSampleCount = sourceSampleCounts[key];
+        job.sampleCount       = pcmPitchShiftLength(job.sourceSampleCount, job.note - job.sourceNote);
+    }
+
+    return SERR_OK;
+}
 
-            std::ifstream srcJsonFile(pDir / std::format("{}_{}.json", closest, velocity));
+synthErrno Fill::printPlan(const std::filesystem::path &pDir, const std::vector<FillJob> &pJobs, const FillOptions &pOptions) {
+    u64 pcmBytes  = 0;
+    u64 wavBytes  = 0;
+    u64 pcmBlocks = 0;
 
-            ordered_json srcJson;
-            srcJsonFile >> srcJson;
+    printf("Fill plan for %s:\n", pDir.generic_string().c_str());
 
-            // used instead of variable factor because of rounding errors
-            auto dstToSrcRatio = (double) dstSampleCount / (double) srcSampleCount;
+    for (const auto &job: pJobs)
+    {
+        u64 bytes = job.sampleCount * sizeof(s16);
 
-            srcJson["loopStart"]    = (int) round(srcJson["loopStart"].get<int>() * dstToSrcRatio);
-            srcJson["loopDuration"] = (int) round(srcJson["loopDuration"].get<int>() * dstToSrcRatio);
+        pcmBytes += bytes;
+        wavBytes += sizeof(wavHeader) + bytes;
+        pcmBlocks += roundUpTo(bytes, BLOCK_SIZE) / BLOCK_SIZE;
 
-            std::ofstream dstJsonFile(pDir / std::format("{}_{}.json", i, velocity));
-            dstJsonFile << srcJson.dump(4);
+        printf("\t- %3d_%-3d <- %3d_%-3d (%+3d st) %9zu samples\n", job.note, job.velocity, job.sourceNote, job.velocity,
+               job.note - job.sourceNote, job.sampleCount);
+    }
+
+    // mkimg pads every sample's pcm to a block and adds one sfsInstrumentSample per sample
+    u64 infoBlocks  = roundUpTo(pJobs.size() * sizeof(sfsInstrumentSample), BLOCK_SIZE) / BLOCK_SIZE;
+    u64 imageBlocks = pcmBlocks + infoBlocks;
+    u64 imageBytes  = imageBlocks * BLOCK_SIZE;
+    f64 flashSecs   = imageBytes / (pOptions.flashRateMiB * 1024.0 * 1024.0);
+
+    printf("\n\t- %zu outputs, %.2f MiB of PCM, %.2f MiB of wav files\n", pJobs.size(), pcmBytes / (1024.0 * 1024.0),
+           wavBytes / (1024.0 * 1024.0));
+    printf("\t- image grows by ~%llu blocks (%.2f MiB), ~%.1f s extra flashing at %.1f MiB/s\n", (unsigned long long) imageBlocks,
+           imageBytes / (1024.0 * 1024.0), flashSecs, pOptions.flashRateMiB);
+    printf("\t- fill --virtual adds no blocks, the device shifts the closest sample instead\n");
+
+    return SERR_OK;
+}
 
-            delete[] srcBuf;
-            delete[] dstSamples;
+synthErrno Fill::fillVirtual(const std::filesystem::path &pDir, const std::vector<FillJob> &pJobs) {
+    auto          configPath = pDir / "instrument.json";
+    std::ifstream configIn(configPath);
+    if (!configIn.is_open())
+    {
+        return SERR_GENERIC_ERROR;
+    }
+
+    ordered_json config = ordered_json::parse(configIn);
+    configIn.close();
+
+    // mkimg picks the closest sample per key anyway, the flag only makes it record how far off that sample is
+    config["virtualFill"] = true;
+
+    std::ofstream configOut(configPath);
+    configOut << config.dump(4);
+    configOut.close();
+
+    std::set<int> keys;
+    u64           skippedBytes = 0;
+
+    for (const auto &job: pJobs)
+    {
+        keys.insert(job.note);
+        skippedBytes += job.sampleCount * sizeof(s16);
+    }
+
+    printf("Virtually filled %zu keys, %.2f MiB of shifted PCM not materialized.\n", keys.size(), skippedBytes / (1024.0 * 1024.0));
+
+    return SERR_OK;
+}
+
+synthErrno Fill::fill(std::filesystem::path pDir, const FillOptions &pOptions) {
+    std::vector<FillJob> jobs;
+
+    synthErrno ret = collectJobs(pDir, jobs);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    ret = measureJobs(pDir, jobs);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    if (pOptions.plan)
+    {
+        return printPlan(pDir, jobs, pOptions);
+    }
+
+    if (pOptions.virtualFill)
+    {
+        return fillVirtual(pDir, jobs);
+    }
+
+    ThreadPool pool(pOptions.jobs);
+
+    // every source is mapped and its json parsed exactly once, a source typically feeds several neighbouring notes
+    FillSourceCache                   sources;
+    std::vector<std::pair<int, int> > sourceKeys;
+    std::vector<FillSource *>         sourcePtrs;
+
+    for (const auto &job: jobs)
+    {
+        auto key = std::pair(job.sourceNote, job.velocity);
+        if (!sources.contains(key))
+        {
+            sourceKeys.push_back(key);
+            sourcePtrs.push_back(&sources[key]);
+        }
+    }
+
+    std::vector<synthErrno> sourceResults(sourceKeys.size(), SERR_OK);
+    pool.parallelFor(sourceKeys.size(), [&](size_t pIdx) {
+        sourceResults[pIdx] = loadSource(pDir, sourceKeys[pIdx].first, sourceKeys[pIdx].second, *sourcePtrs[pIdx]);
+    });
+
+    for (auto result: sourceResults)
+    {
+        if (result != SERR_OK)
+        {
+            return result;
+        }
+    }
+
+    // every job reads only source notes (closest != note) and writes its own pair of files, so jobs never touch
+    // each other's outputs and the result does not depend on scheduling
+    std::vector<synthErrno> results(jobs.size(), SERR_OK);
+
+    pool.parallelFor(jobs.size(), [&](size_t pIdx) {
+        const auto &job = jobs[pIdx];
+        results[pIdx]   = runJob(pDir, job, sources.at({job.sourceNote, job.velocity}), pOptions);
+    });
+
+    for (auto result: results)
+    {
+        if (result != SERR_OK)
+        {
+            return result;
         }
     }
 
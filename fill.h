@@ -6,14 +6,55 @@
 #ifndef FILL_H
 #define FILL_H
 #include <filesystem>
+#include <map>
+#include <vector>
 
+#include "json.hpp"
+#include "mapped_file.h"
+#include "pcm.h"
 #include "serrno.h"
 
+// one pitch-shifted output: <note>_<velocity>.wav generated from <sourceNote>_<velocity>.wav
+struct FillJob {
+    int note;
+    int sourceNote;
+    int velocity;
+
+    // filled from the source wav header by Fill::measureJobs, no audio is read
+    size_t sourceSampleCount;
+    size_t sampleCount;
+};
+
+struct FillOptions {
+    size_t           jobs          = 1; // 0 uses every hardware thread
+    pcmInterpolation interpolation = PCM_INTERPOLATION_LINEAR;
+    bool             virtualFill   = false; // no new wavs, mkimg stores per key semitone offsets instead
+    bool             plan          = false; // only report what would be written
+    f64              flashRateMiB  = 10.0;  // sustained sd write speed the plan's time estimate assumes
+};
+
+// a source sample loaded once and shared read-only by every job that pitch-shifts it
+struct FillSource {
+    MappedFile             wav;
+    nlohmann::ordered_json json;
+    const s16             *samples;
+    size_t                 sampleCount;
+};
+
+// keyed by (source note, velocity)
+typedef std::map<std::pair<int, int>, FillSource> FillSourceCache;
+
 class Fill {
 private:
+    static synthErrno collectJobs(const std::filesystem::path &pDir, std::vector<FillJob> &pJobs);
+    static synthErrno loadSource(const std::filesystem::path &pDir, int pNote, int pVelocity, FillSource &pSource);
+    static synthErrno measureJobs(const std::filesystem::path &pDir, std::vector<FillJob> &pJobs);
+    static synthErrno fillVirtual(const std::filesystem::path &pDir, const std::vector<FillJob> &pJobs);
+    static synthErrno printPlan(const std::filesystem::path &pDir, const std::vector<FillJob> &pJobs, const FillOptions &pOptions);
+    static synthErrno runJob(const std::filesystem::path &pDir, const FillJob &pJob, const FillSource &pSource, const FillOptions &pOptions);
 
 public:
-    static synthErrno fill(std::filesystem::path pDir);
+    static synthErrno fill(std::filesystem::path pDir, const FillOptions &pOptions);
 };
 
 #endif //FILL_H
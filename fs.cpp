@@ -5,8 +5,27 @@
 
 #include "fs.h"
 
+#include <array>
+#include <cmath>
+#include <cstring>
+#include <format>
 #include <fstream>
-#include <regex>
+#include <limits>
+#include <unordered_map>
+
+#include "build_metrics.h"
+#include "crc32c.h"
+#include "hash.h"
+#include "image_checksum.h"
+#include "manifest.h"
+#include "mapped_file.h"
+#include "pattern_matcher.h"
+#include "pcm.h"
+#include "proximity_table.h"
+#include "resident_plan.h"
+#include "riff_reader.h"
+#include "sfs_image.h"
+#include "thread_pool.h"
 
 extern "C" {
 #include <wav/wav.h>
@@ -32,10 +51,8 @@ void SynthFs::padStream(std::ostream &pOstream, size_t pTo) {
         return;
     }
 
-    for (int i = 0; i < pTo - (pos % pTo); ++i)
-    {
-        pOstream.put(0);
-    }
+    std::vector<char> zeros(pTo - pos % pTo, 0);
+    pOstream.write(zeros.data(), zeros.size());
 }
 
 size_t SynthFs::writeFileToOfstream(std::ofstream &pOfstream, const char *pFile) {
@@ -69,10 +86,7 @@ size_t writeStreamToFile(const std::filesystem::path &pFile, std::istream &pStre
 }
 
 void SynthFs::copyStream(std::ofstream &pOfstream, std::ifstream &pIfstream) {
-    while (!pIfstream.eof())
-    {
-        pOfstream.put(pIfstream.get());
-    }
+    pOfstream << pIfstream.rdbuf();
 }
 
 std::string bytesToStr(uint64_t bytes) {
@@ -92,33 +106,351 @@ std::string bytesToStr(uint64_t bytes) {
     return output;
 }
 
-synthErrno sfsReadBlocks(u8 *pData, u32 pBlkIdx, u32 pBlkCnt) {
-    return SERR_SD_GENERIC_ERROR;
+static u32 blocksFor(size_t pBytes) {
+    return roundUpTo(pBytes, BLOCK_SIZE) / BLOCK_SIZE;
 }
 
-synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder) {
-    solfegeInit();
+static const std::pair<const char *, sfsSampleEncoding> sampleEncodingNames[] = {
+    {"pcm16", SFS_SAMPLE_ENCODING_PCM16},
+    {"adpcm", SFS_SAMPLE_ENCODING_ADPCM},
+    {"lossless", SFS_SAMPLE_ENCODING_LOSSLESS},
+};
+
+bool SynthFs::parseEncoding(const std::string &pName, sfsSampleEncoding &pEncoding) {
+    for (const auto &[name, encoding]: sampleEncodingNames)
+    {
+        if (pName == name)
+        {
+            pEncoding = encoding;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *SynthFs::encodingName(sfsSampleEncoding pEncoding) {
+    for (const auto &[name, encoding]: sampleEncodingNames)
+    {
+        if (pEncoding == encoding)
+        {
+            return name;
+        }
+    }
+
+    return "unknown";
+}
+
+u32 SynthFs::encodedBlocks(sfsSampleEncoding pEncoding, u32 pDataSize) {
+    if (pEncoding == SFS_SAMPLE_ENCODING_ADPCM)
+    {
+        return adpcmBlocksFor(pDataSize / SAMPLE_SIZE);
+    }
+
+    // no frame is larger than its raw pcm, the encode pass replaces this with the real size
+    if (pEncoding == SFS_SAMPLE_ENCODING_LOSSLESS)
+    {
+        return losslessIndexBlocks(pDataSize / SAMPLE_SIZE) + blocksFor(pDataSize);
+    }
+
+    return blocksFor(pDataSize);
+}
+
+bool SynthFs::samePcm(const MappedFile &pA, const SamplePcmSource &pSourceA, const MappedFile &pB, const SamplePcmSource &pSourceB) {
+    if (pSourceA.dataSize != pSourceB.dataSize || !pA.isOpen() || !pB.isOpen() ||
+        pSourceA.dataOffset + pSourceA.dataSize > pA.size() || pSourceB.dataOffset + pSourceB.dataSize > pB.size())
+    {
+        return false;
+    }
+
+    return memcmp(pA.data() + pSourceA.dataOffset, pB.data() + pSourceB.dataOffset, pSourceA.dataSize) == 0;
+}
+
+// SampleAnalysis measures a start and an end window of this many samples, shorter samples are split in half
+static u64 analysisWindow(u64 pLength) {
+    constexpr u64 expectedAverageAmplitudeArea = 10000;
+
+    if (pLength > expectedAverageAmplitudeArea * 2)
+    {
+        return expectedAverageAmplitudeArea;
+    }
+
+    return pLength >= 2 ? pLength / 2 - 1 : 0;
+}
+
+// adds the pCount samples at pFirst of a pLength samples long sample to the start, middle and end windows they fall
+// in. every sample lands in exactly one of them, the start and end windows never overlap
+static void analyzeWindows(const s16 *pPcm, u64 pFirst, u64 pCount, u64 pLength, std::array<PcmStats, 3> &pStats) {
+    u64 window = analysisWindow(pLength);
+    u64 end    = pFirst + pCount;
+
+    u64 startCut = std::min(std::max(window, pFirst), end);
+    u64 endCut   = std::min(std::max(pLength - window, startCut), end);
+
+    pcmAnalyze(pPcm, startCut - pFirst, pStats[0]);
+    pcmAnalyze(pPcm + (startCut - pFirst), endCut - startCut, pStats[1]);
+    pcmAnalyze(pPcm + (endCut - pFirst), end - endCut, pStats[2]);
+}
+
+static void finishAnalysis(const std::array<PcmStats, 3> &pStats, SampleAnalysis &pOut) {
+    auto meanAbs = [](const PcmStats &pStats) {
+        return pStats.count ? (u16) (pStats.sumAbs / pStats.count) : (u16) 0;
+    };
+
+    auto rms = [](const PcmStats &pStats) {
+        return pStats.count ? (u16) std::min(std::sqrt((f64) pStats.sumSquares / pStats.count), 32768.0) : (u16) 0;
+    };
+
+    PcmStats total = {};
+    for (const auto &stats: pStats)
+    {
+        pcmStatsAdd(total, stats);
+    }
+
+    pOut.startMeanAbs = meanAbs(pStats[0]);
+    pOut.endMeanAbs   = meanAbs(pStats[2]);
+    pOut.startRms     = rms(pStats[0]);
+    pOut.endRms       = rms(pStats[2]);
+    pOut.peak         = (u16) total.peak;
+    pOut.dcOffset     = total.count ? (s16) (total.sum / (s64) total.count) : (s16) 0;
+    pOut.valid        = true;
+}
+
+synthErrno SynthFs::streamSamplePcm(ImageWriter &pOut, const SamplePcmSource &pSource, sfsSampleEncoding pEncoding, SampleAnalysis &pAnalysis) {
+    std::ifstream in(pSource.file, std::ios_base::binary | std::ios_base::in);
+    if (!in.is_open())
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    in.seekg(pSource.dataOffset, std::ios_base::beg);
+
+    u64                     sampleLengthSamples = pSource.dataSize / 2;
+    std::array<PcmStats, 3> stats               = {};
+
+    // adpcm samples are read a run of whole blocks at a time into here and encoded from it into the writer
+    std::vector<s16> staging;
+    u8               adpcmIndex = 0;
+
+    if (pEncoding == SFS_SAMPLE_ENCODING_ADPCM)
+    {
+        staging.resize(FS_ENCODE_CHUNK_BLOCKS * SFS_ADPCM_SAMPLES_PER_BLOCK);
+    }
+
+    pAnalysis.codecError = {};
+
+    u64    sampleIdx = 0;
+    size_t remaining = pSource.dataSize;
+    while (remaining > 0)
+    {
+        // raw pcm is read straight into the writer's staging buffer and analysed there, touched once on its way
+        size_t space;
+        u8    *chunk = staging.empty() ? pOut.reserve(2, space) : (u8 *) staging.data();
+        size_t len   = std::min(remaining, staging.empty() ? space & ~(size_t) 1 : staging.size() * SAMPLE_SIZE);
+
+        in.read((str) chunk, len);
+
+        // a truncated wav still occupies its full size in the layout, the missing tail is silence
+        size_t got = in.gcount();
+        if (got < len)
+        {
+            memset(chunk + got, 0, len - got);
+        }
+
+        // chunks are a whole number of samples, only the very last one can end on half a sample
+        auto pcm   = (const s16 *) chunk;
+        u64  count = len / 2;
+
+        analyzeWindows(pcm, sampleIdx, count, sampleLengthSamples, stats);
+        sampleIdx += count;
+
+        if (staging.empty())
+        {
+            pOut.commit(len);
+        }
+        else
+        {
+            // a trailing half sample is dropped here, pcmDataLengthSamples does not count it either
+            size_t blockBytes = (size_t) adpcmBlocksFor(count) * BLOCK_SIZE;
+            u8    *dst        = pOut.reserve(blockBytes, space);
+
+            adpcmEncode(pcm, count, dst, adpcmIndex, pAnalysis.codecError);
+            pOut.commit(blockBytes);
+        }
+
+        remaining -= len;
+    }
+
+    finishAnalysis(stats, pAnalysis);
+
+    return SERR_OK;
+}
+
+// pSize bytes at pOffset of the lossless scratch file into the image
+static synthErrno copySpilled(ImageWriter &pOut, std::istream &pSpill, u64 pOffset, u64 pSize) {
+    pSpill.seekg(pOffset, std::ios_base::beg);
+
+    while (pSize > 0)
+    {
+        size_t space;
+        u8    *dst = pOut.reserve(1, space);
+        size_t len = std::min<u64>(pSize, space);
+
+        pSpill.read((str) dst, len);
+        if ((size_t) pSpill.gcount() != len)
+        {
+            return SERR_SD_READ_ERROR;
+        }
+
+        pOut.commit(len);
+        pSize -= len;
+    }
+
+    return SERR_OK;
+}
+
+synthErrno SynthFs::ingestInstrument(const std::filesystem::path &pInstrumentPath, IngestedInstrument &pOut) {
+    std::ifstream instrumentJson(pInstrumentPath / "instrument.json");
+    std::string   configText((std::istreambuf_iterator(instrumentJson)), {});
+    instrumentJson.close();
+
+    nlohmann::json config = nlohmann::json::parse(configText);
+
+    pOut.metaHash  = hashFnv1a(configText);
+    pOut.bytesRead = configText.size();
+
+    sfsSoundType soundType = SFS_SOUND_TYPE_ATTACK;
+    if (config["looping"])
+    {
+        soundType |= SFS_SOUND_TYPE_LOOP;
+    }
+
+    pOut.instrument           = {};
+    pOut.instrument.soundType = soundType;
+    pOut.instrument.release   = config["release"];
+
+    pOut.name = config["name"];
+
+    // virtually filled instruments keep only their real samples, the device pitch-shifts the closest one
+    pOut.virtualFill = config.value("virtualFill", false);
+
+    pOut.encoding = SFS_SAMPLE_ENCODING_PCM16;
+    if (!parseEncoding(config.value("encoding", std::string("pcm16")), pOut.encoding))
+    {
+        return SERR_SFS_INVALID_ENCODING;
+    }
+
+    pOut.attackBlocks = config.value("attackBlocks", -1);
+
+    return SERR_OK;
+}
+
+synthErrno SynthFs::ingestSample(const std::filesystem::path &pInstrumentPath, const IngestedInstrument &pInstrument, IngestedSample &pOut) {
+    auto sampleFilenameBase = std::to_string(pOut.semitone) + "_" + std::to_string(pOut.velocity);
+    auto sampleFileEnt      = pInstrumentPath / (sampleFilenameBase + ".wav");
+    auto sampleFileJson     = pInstrumentPath / (sampleFilenameBase + ".json");
+
+    nlohmann::json sampleJson = loadJson(sampleFileJson.generic_string().c_str());
+
+    // the manifest compares these against the last build, a loop point tweak changes metaHash but not pcmStamp
+    pOut.metaHash = hashFnv1a(sampleFilenameBase);
+    if (sampleJson != nullptr)
+    {
+        pOut.metaHash = hashFnv1a(sampleJson.dump(), pOut.metaHash);
+    }
+
+    std::error_code ec;
+    auto            wavSize  = std::filesystem::file_size(sampleFileEnt, ec);
+    auto            wavMtime = std::filesystem::last_write_time(sampleFileEnt, ec).time_since_epoch().count();
+
+    pOut.pcmStamp = hashFnv1aValue(wavMtime, hashFnv1aValue(wavSize, hashFnv1a(sampleFilenameBase)));
+    pOut.pcmStamp = hashFnv1aValue(pInstrument.encoding, pOut.pcmStamp);
+
+    MappedFile wav;
+    if (!wav.open(sampleFileEnt))
+    {
+        return SERR_SFS_INVALID_WAV;
+    }
+
+    RiffWavInfo wavInfo;
+    synthErrno  ret = RiffReader::parse(wav.data(), wav.size(), wavInfo);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    if (wavInfo.sampleRate != SFS_SAMPLERATE)
+    {
+        return SERR_SFS_INVALID_SAMPLERATE;
+    }
+
+    u32 dataSize            = wavInfo.dataSize;
+    u32 sampleLengthSamples = dataSize / 2;
+
+    // the parse only walks the chunk headers, the pcm is read by the phases that hash, encode and write it
+    pOut.bytesRead = (wav.size() - dataSize) + (sampleJson != nullptr ? std::filesystem::file_size(sampleFileJson, ec) : 0);
+
+    sfsInstrumentSample sample = {};
+
+    sample.pcmDataLengthSamples = sampleLengthSamples;
+
+    auto soundType = pInstrument.instrument.soundType;
+    if (soundType & SFS_SOUND_TYPE_LOOP && sampleJson == nullptr && wavInfo.hasLoop)
+    {
+        // no loop json next to the wav, fall back to the loop embedded in its smpl chunk
+        sample.loopStart    = wavInfo.loopStart;
+        sample.loopDuration = wavInfo.loopEnd - wavInfo.loopStart + 1;
+    }
+    else if (soundType & SFS_SOUND_TYPE_LOOP)
+    {
+        sample.loopStart    = (u32) sampleJson["loopStart"].get<int>();
+        sample.loopDuration = (u32) sampleJson["loopDuration"].get<int>();
+    }
+    else
+    {
+        sample.loopStart    = 0;
+        sample.loopDuration = 0;
+    }
+
+    sample.velocity       = pOut.velocity;
+    sample.pitchSemitones = pOut.semitone;
+    sample.encoding       = pInstrument.encoding;
+
+    pOut.sample = sample;
 
-    std::ofstream sfsImgOut("synth.bin", std::ios_base::out | std::ios_base::binary);
+    // pcm is only located here, it is streamed into the image (and its amplitudes measured) when written
+    pOut.source = {sampleFileEnt, wavInfo.dataOffset, dataSize};
+
+    return SERR_OK;
+}
+
+synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder, const ImageBuildOptions &pOptions) {
+    BuildMetrics metrics;
+    metrics.begin("scan");
+
+    solfegeInit();
 
     std::vector<sfsSingleInstrument>  singleInstrumentPool;
     std::vector<sfsInstrumentSample>  samplePool;
     std::vector<std::string>          namePool;
-    std::vector<std::vector<u8> >     sampleDataPool;
+    std::vector<SamplePcmSource>      sampleSourcePool;
     std::vector<sfsKeyProximityTable> proximityTablePool;
 
     std::map<std::string, u16>                                                           mapInstrumentStringIdToNumId;
     std::map<std::filesystem::path, std::map<u8, std::vector<std::pair<u8, size_t> > > > mapProximity;
 
-    u32 currentSampleBlockOffset = 0;
-    u32 currentNameOffset        = 0;
-    u32 currentInstrumentId      = 0;
-    u32 currentSampleId          = 0;
+    u32 currentNameOffset   = 0;
+    u32 currentInstrumentId = 0;
+    u32 currentSampleId     = 0;
 
     u32 singleInstrumentCount = 0;
     u32 multiInstrumentCount  = 0;
 
-    for (const auto &instrumentsEnt: std::filesystem::directory_iterator(pInstrumentsFolder))
+    // directory order is up to the filesystem, sort it so instrument ids do not change between machines
+    std::vector<std::filesystem::directory_entry> instrumentEntries(std::filesystem::directory_iterator(pInstrumentsFolder), {});
+    std::ranges::sort(instrumentEntries);
+
+    for (const auto &instrumentsEnt: instrumentEntries)
     {
         if (!instrumentsEnt.is_directory())
         {
@@ -199,33 +531,144 @@ synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder) {
         }
     }
 
-    printf("Instruments:\n");
-    for (auto &instrumentPath: mapProximity | std::ranges::views::keys)
+    // ingestion: instrument configs, loop jsons and wav headers are independent of each other, so they are parsed on
+    // the pool. samples are flattened in mapProximity order, which is also their global index order.
+    std::vector<std::filesystem::path> instrumentPaths;
+    std::vector<IngestedSample>        ingestedSamples;
+
+    for (const auto &[instrumentPath, semitones]: mapProximity)
     {
-        printf("\t- Instrument %ls\n", instrumentPath.filename().c_str());
+        instrumentPaths.push_back(instrumentPath);
 
-        u8 noteRangeStart = 0xFF, noteRangeEnd = 0;
+        for (const auto &[semitone, velocities]: semitones)
+        {
+            for (const auto &velocity: velocities | std::views::keys)
+            {
+                IngestedSample ingested = {};
+                ingested.instrumentIdx  = instrumentPaths.size() - 1;
+                ingested.semitone       = semitone;
+                ingested.velocity       = velocity;
+
+                ingestedSamples.push_back(ingested);
+            }
+        }
+    }
+
+    std::vector<IngestedInstrument> ingestedInstruments(instrumentPaths.size());
 
-        sfsSingleInstrument instrument = {};
+    ThreadPool pool(pOptions.jobs);
+    metrics.counter("jobs", pool.threadCount());
 
-        std::ifstream  instrumentJson(instrumentPath / "instrument.json");
-        nlohmann::json config = nlohmann::json::parse(instrumentJson);
-        instrumentJson.close();
+    {
+        auto &phase = metrics.begin("json");
+        pool.parallelFor(instrumentPaths.size(), [&](size_t pIdx) {
+            ingestedInstruments[pIdx].ret = ingestInstrument(instrumentPaths[pIdx], ingestedInstruments[pIdx]);
+        });
 
-        sfsSoundType soundType = SFS_SOUND_TYPE_ATTACK;
-        if (config["looping"])
+        for (const auto &ingested: ingestedInstruments)
         {
-            soundType |= SFS_SOUND_TYPE_LOOP;
+            if (ingested.ret != SERR_OK)
+            {
+                return ingested.ret;
+            }
+
+            phase.bytesRead += ingested.bytesRead;
         }
+    }
 
-        instrument.nameStrIndex = namePool.size();
-        instrument.soundType    = soundType;
-        instrument.release      = config["release"];
+    {
+        auto &phase = metrics.begin("wav");
+        pool.parallelFor(ingestedSamples.size(), [&](size_t pIdx) {
+            auto &ingested = ingestedSamples[pIdx];
+            ingested.ret   = ingestSample(instrumentPaths[ingested.instrumentIdx], ingestedInstruments[ingested.instrumentIdx], ingested);
+        });
+
+        phase.samples = ingestedSamples.size();
+        for (const auto &ingested: ingestedSamples)
+        {
+            phase.bytesRead += ingested.ret == SERR_OK ? ingested.bytesRead : 0;
+        }
+    }
+
+    // only pcm whose encoding and size another sample shares can be a duplicate, so only that pcm is read and hashed
+    {
+        auto &phase = metrics.begin("hash");
+
+        auto sizeKey = [](const IngestedSample &pSample) {
+            return hashFnv1aValue(pSample.sample.encoding, hashFnv1aValue(pSample.source.dataSize));
+        };
+
+        std::unordered_map<u64, u32> sizeCounts;
+        for (const auto &ingested: ingestedSamples)
+        {
+            if (ingested.ret == SERR_OK)
+            {
+                sizeCounts[sizeKey(ingested)]++;
+            }
+        }
+
+        std::vector<size_t> hashed;
+        for (size_t i = 0; i < ingestedSamples.size(); i++)
+        {
+            if (ingestedSamples[i].ret == SERR_OK && sizeCounts[sizeKey(ingestedSamples[i])] > 1)
+            {
+                hashed.push_back(i);
+            }
+        }
+
+        pool.parallelFor(hashed.size(), [&](size_t pIdx) {
+            auto      &ingested = ingestedSamples[hashed[pIdx]];
+            const auto &source  = ingested.source;
+
+            // a wav that can no longer be mapped is left unhashed and stored on its own, writing it reports the error
+            MappedFile wav;
+            if (wav.open(source.file) && source.dataOffset + source.dataSize <= wav.size())
+            {
+                ingested.pcmHash   = hashFnv1a(wav.data() + source.dataOffset, source.dataSize, sizeKey(ingested));
+                ingested.pcmHashed = true;
+            }
+        });
+
+        phase.samples = hashed.size();
+        for (size_t i: hashed)
+        {
+            phase.bytesRead += ingestedSamples[i].pcmHashed ? ingestedSamples[i].source.dataSize : 0;
+        }
+    }
+
+    metrics.begin("merge").samples = ingestedSamples.size();
+
+    // merge: serial and in path order, so ids, names and offsets match a single threaded build byte for byte
+    ImageManifest manifest = {};
+
+    // identical pcm (unison fills, shared zones, instrument variants) is stored once, the duplicates point at the
+    // first copy. layoutSamples[i].owner is the sample whose copy sample i uses, i itself for stored samples. the
+    // wavs of owners some other sample's hash matched stay mapped for the comparisons that follow, a mapping holds
+    // no file descriptor so any number of them can
+    std::unordered_map<u64, std::vector<u32> > samplesByPcmHash;
+    std::unordered_map<u32, MappedFile>        ownerWavs;
+    std::vector<PcmLayoutSample>               layoutSamples;
+    size_t                                     dedupCount = 0;
+    size_t                                     dedupBytes = 0;
+
+    printf("Instruments:\n");
+
+    size_t sampleCursor = 0;
+    for (size_t instrumentIdx = 0; instrumentIdx < instrumentPaths.size(); instrumentIdx++)
+    {
+        const auto &instrumentPath = instrumentPaths[instrumentIdx];
+        auto       &ingested       = ingestedInstruments[instrumentIdx];
 
-        std::string name = config["name"];
-        namePool.push_back(name);
+        printf("\t- Instrument %ls\n", instrumentPath.filename().c_str());
+
+        u8 noteRangeStart = 0xFF, noteRangeEnd = 0;
+
+        sfsSingleInstrument instrument = ingested.instrument;
 
-        currentNameOffset += name.length() + 1;
+        instrument.nameStrIndex = namePool.size();
+        namePool.push_back(ingested.name);
+
+        currentNameOffset += ingested.name.length() + 1;
 
         sfsKeyProximityTable table = {};
         table.sampleIdxOrigin      = currentSampleId;
@@ -252,8 +695,9 @@ synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder) {
 
                 sfsKeyProximityTableEntryVelocity entry = {};
 
-                entry.velocity  = velocity;
-                entry.sampleIdx = idx - table.sampleIdxOrigin;
+                entry.velocity       = velocity;
+                entry.sampleIdx      = idx - table.sampleIdxOrigin;
+                entry.semitoneOffset = ingested.virtualFill ? key - closest : 0;
 
                 entryMaster.byVelocity[j++] = entry;
             }
@@ -263,115 +707,95 @@ synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder) {
 
         proximityTablePool.push_back(table);
 
-        for (auto &pair0: mapProximity[instrumentPath])
+        ManifestInstrument manifestEntry = {};
+        manifestEntry.id                 = instrumentPath.filename().string();
+        manifestEntry.metaHash           = ingested.metaHash;
+        manifestEntry.pcmStamp           = HASH_FNV1A_SEED;
+        manifestEntry.sampleIdxOrigin    = currentSampleId;
+
+        for (; sampleCursor < ingestedSamples.size() && ingestedSamples[sampleCursor].instrumentIdx == instrumentIdx; sampleCursor++)
         {
-            u8   sampleSemitoneOff = pair0.first;
-            auto vec               = pair0.second;
-            for (auto &pair: vec)
+            auto &ingestedSample = ingestedSamples[sampleCursor];
+            if (ingestedSample.ret != SERR_OK)
             {
-                u8 sampleVelocity = pair.first;
+                return ingestedSample.ret;
+            }
 
-                auto sampleFilenameBase = std::to_string(sampleSemitoneOff) + "_" + std::to_string(sampleVelocity);
-                auto sampleFileEnt      = instrumentPath / (sampleFilenameBase + ".wav");
-                auto sampleFileJson     = instrumentPath / (sampleFilenameBase + ".json");
+            u8 sampleSemitoneOff = ingestedSample.semitone;
 
-                nlohmann::json sampleJson = loadJson(sampleFileJson.generic_string().c_str());
+            if (sampleSemitoneOff > noteRangeEnd)
+            {
+                noteRangeEnd = sampleSemitoneOff;
+            }
 
-                if (sampleSemitoneOff > noteRangeEnd)
-                {
-                    noteRangeEnd = sampleSemitoneOff;
-                }
+            if (sampleSemitoneOff < noteRangeStart)
+            {
+                noteRangeStart = sampleSemitoneOff;
+            }
 
-                if (sampleSemitoneOff < noteRangeStart)
-                {
-                    noteRangeStart = sampleSemitoneOff;
-                }
+            sfsInstrumentSample sample = ingestedSample.sample;
 
-                std::ifstream fileStream(sampleFileEnt, std::ios_base::binary | std::ios_base::in);
-                std::string   readData;
-                u32           sampleRate = 0;
+            u32 owner = currentSampleId;
+            if (ingestedSample.pcmHashed)
+            {
+                auto      &candidates = samplesByPcmHash[ingestedSample.pcmHash];
+                MappedFile wav;
 
-                while (!fileStream.eof())
+                for (u32 candidate: candidates)
                 {
-                    readData += (char) fileStream.get();
-
-                    std::string::size_type i;
-                    if (!sampleRate && (i = readData.find("fmt ")) != std::string::npos)
+                    // both were hashed through a mapping moments ago, a wav that cannot be mapped now went missing
+                    if (!wav.isOpen() && !wav.open(ingestedSample.source.file))
                     {
-                        fileStream.seekg(0xC - 4, std::ios_base::cur);
-                        fileStream.read((str) &sampleRate, 4);
-                        fileStream.seekg(-8 - 4, std::ios_base::cur);
+                        return SERR_SFS_INVALID_WAV;
+                    }
 
-                        if (sampleRate != SFS_SAMPLERATE)
-                        {
-                            return SERR_SFS_INVALID_SAMPLERATE;
-                        }
+                    auto &ownerWav = ownerWavs[candidate];
+                    if (!ownerWav.isOpen() && !ownerWav.open(sampleSourcePool[candidate].file))
+                    {
+                        return SERR_SFS_INVALID_WAV;
                     }
-                    else if ((i = readData.find("data")) != std::string::npos)
+
+                    if (samePcm(ownerWav, sampleSourcePool[candidate], wav, ingestedSample.source))
                     {
+                        owner = candidate;
                         break;
                     }
                 }
 
-                u32 dataSize;
-                fileStream.read((str) &dataSize, 4);
-                u32 sampleLengthSamples = dataSize / 2;
-
-                sfsInstrumentSample sample = {};
-
-                sample.pcmDataLengthSamples = sampleLengthSamples;
-                sample.pcmDataBlockOffset   = currentSampleBlockOffset;
-
-                currentSampleBlockOffset += roundUpTo(dataSize, BLOCK_SIZE) / BLOCK_SIZE;
-
-                if (soundType & SFS_SOUND_TYPE_LOOP)
+                if (owner == currentSampleId)
                 {
-                    sample.loopStart    = (u32) sampleJson["loopStart"].get<int>();
-                    sample.loopDuration = (u32) sampleJson["loopDuration"].get<int>();
+                    candidates.push_back(currentSampleId);
+                    if (wav.isOpen())
+                    {
+                        ownerWavs[currentSampleId] = std::move(wav);
+                    }
                 }
                 else
                 {
-                    sample.loopStart    = 0;
-                    sample.loopDuration = 0;
+                    dedupCount++;
                 }
+            }
 
-                sample.velocity       = sampleVelocity;
-                sample.pitchSemitones = sampleSemitoneOff;
-
-                auto sampleData = std::vector<u8>(dataSize);
-                fileStream.read((str) sampleData.data(), dataSize);
-
-                u32 amp1 = 0, amp2 = 0;
-
-                constexpr int expectedAverageAmplitudeArea = 10000;
-                int           averageAmplitudeArea;
-
-                if (sampleLengthSamples > expectedAverageAmplitudeArea * 2)
-                {
-                    averageAmplitudeArea = expectedAverageAmplitudeArea;
-                }
-                else
-                {
-                    averageAmplitudeArea = sampleLengthSamples / 2 - 1;
-                }
+            PcmLayoutSample layoutSample = {};
+            layoutSample.instrumentIdx   = instrumentIdx;
+            layoutSample.semitone        = ingestedSample.semitone;
+            layoutSample.velocity        = ingestedSample.velocity;
+            layoutSample.blocks          = encodedBlocks(sample.encoding, ingestedSample.source.dataSize);
+            layoutSample.owner           = owner;
 
-                for (size_t i = 0; i < averageAmplitudeArea; i++)
-                {
-                    amp1 += *((u16 *) sampleData.data() + i);
-                    amp2 += *((u16 *) sampleData.data() + sampleData.size() / 2 - i - 1);
-                }
+            layoutSamples.push_back(layoutSample);
+            sampleSourcePool.push_back(ingestedSample.source);
+            samplePool.push_back(sample);
 
-                sample.startAverageAmplitude = amp1 / averageAmplitudeArea;
-                sample.endAverageAmplitude   = amp2 / averageAmplitudeArea;
+            manifestEntry.metaHash = hashFnv1aValue(ingestedSample.metaHash, manifestEntry.metaHash);
+            manifestEntry.pcmStamp = hashFnv1aValue(ingestedSample.pcmStamp, manifestEntry.pcmStamp);
 
-                samplePool.push_back(sample);
-                sampleDataPool.push_back(sampleData);
+            currentSampleId++;
+        }
 
-                currentSampleId++;
+        manifestEntry.sampleCount = currentSampleId - manifestEntry.sampleIdxOrigin;
 
-                fileStream.close();
-            }
-        }
+        manifest.instruments.push_back(manifestEntry);
 
         instrument.noteRangeStart = noteRangeStart;
         instrument.noteRangeEnd   = noteRangeEnd;
@@ -379,37 +803,333 @@ synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder) {
         singleInstrumentPool.push_back(instrument);
     }
 
-    u32 instrumentCount = singleInstrumentCount + multiInstrumentCount;
-
-    sfsHeader header = {};
-    header.magic     = SFS_MAGIC;
-
-    sfsImgOut.seekp(BLOCK_SIZE * 1, std::ios_base::beg);
-    printf("\nWriting file: \n");
-
-    // hold behaviours
-    {
-        printf("\t- Writing hold behaviour data...\n");
-        size_t p0 = sfsImgOut.tellp();
+    ownerWavs.clear();
 
-        std::vector<std::vector<sfsHoldBehaviour> > holdBehaviours(singleInstrumentCount);
+    // a lossless sample's size is only known once it is encoded and the layout needs it, so stored lossless samples
+    // are encoded here, every frame of a batch of them side by side, and spilled to a scratch file next to the image
+    // until their pcm is written. they are measured from the same read of their wav
+    std::filesystem::path imagePath    = "synth.bin";
+    std::filesystem::path manifestPath = ImageManifest::pathFor(imagePath);
+    std::filesystem::path spillPath    = imagePath;
+    spillPath += ".lossless";
 
-        sfsHoldBehaviour dummyHold = {};
-        dummyHold.instrumentId     = SFS_INVALID_INSTRUMENT_ID;
+    std::vector<SampleAnalysis> analysisPool(samplePool.size());
+    std::vector<u64>            spillOffsets(samplePool.size(), 0);
+    std::vector<bool>           encodeSkipped(samplePool.size(), false);
+    std::fstream                spill;
 
-        for (size_t i = 0; i < singleInstrumentCount; i++)
+    auto encodeLossless = [&](const std::vector<u32> &pSamples, BuildPhaseMetrics &pPhase) -> synthErrno {
+        if (!pSamples.empty() && !spill.is_open())
         {
-            holdBehaviours[i] = std::vector(1, dummyHold);
+            spill.open(spillPath, std::ios_base::in | std::ios_base::out | std::ios_base::binary | std::ios_base::trunc);
+            if (!spill.is_open())
+            {
+                return SERR_SD_WRITE_ERROR;
+            }
         }
 
-        size_t holdBehaviourCount = 0;
-
-        nlohmann::json holdJson = loadJson("instruments/hold.json");
-        if (holdJson != nullptr)
+        for (size_t batchStart = 0, batchEnd; batchStart < pSamples.size(); batchStart = batchEnd)
         {
-            for (auto it = holdJson.begin(); it != holdJson.end(); ++it)
+            std::vector<MappedFile>                     wavs;
+            std::vector<std::pair<u32, u32> >           jobs; // index into the batch, frame
+            std::vector<std::vector<std::vector<u8> > > frames;
+
+            size_t batchBytes = 0;
+            for (batchEnd = batchStart; batchEnd < pSamples.size() && batchBytes < FS_ENCODE_BATCH_BYTES && wavs.size() < FS_ENCODE_BATCH_FILES; batchEnd++)
             {
-                auto key = it.key();
+                const auto &source = sampleSourcePool[pSamples[batchEnd]];
+
+                MappedFile wav;
+                if (!wav.open(source.file) || source.dataOffset + source.dataSize > wav.size())
+                {
+                    return SERR_SFS_INVALID_WAV;
+                }
+
+                u32 frameCount = losslessFrameCount(samplePool[pSamples[batchEnd]].pcmDataLengthSamples);
+                for (u32 frame = 0; frame < frameCount; frame++)
+                {
+                    jobs.emplace_back(wavs.size(), frame);
+                }
+
+                wavs.push_back(std::move(wav));
+                frames.emplace_back(frameCount);
+                batchBytes += source.dataSize;
+            }
+
+            // what each frame adds to its sample's analysis windows
+            std::vector<std::array<PcmStats, 3> > stats(jobs.size());
+
+            pool.parallelFor(jobs.size(), [&](size_t pIdx) {
+                auto [idx, frame]  = jobs[pIdx];
+                const auto &source = sampleSourcePool[pSamples[batchStart + idx]];
+
+                // copied out since the wav's data chunk need not be aligned to a sample
+                size_t length = source.dataSize / SAMPLE_SIZE;
+                size_t first  = (size_t) frame * SFS_LOSSLESS_FRAME_SAMPLES;
+                size_t count  = std::min<size_t>(SFS_LOSSLESS_FRAME_SAMPLES, length - first);
+
+                std::array<s16, SFS_LOSSLESS_FRAME_SAMPLES> pcm;
+                memcpy(pcm.data(), wavs[idx].data() + source.dataOffset + first * SAMPLE_SIZE, count * SAMPLE_SIZE);
+
+                analyzeWindows(pcm.data(), first, count, length, stats[pIdx]);
+                losslessEncodeFrame(pcm.data(), count, frames[idx][frame]);
+            });
+
+            std::vector<u8> encoded;
+            for (size_t idx = 0, job = 0; idx < frames.size(); idx++)
+            {
+                u32 i = pSamples[batchStart + idx];
+
+                std::array<PcmStats, 3> sampleStats = {};
+                for (; job < jobs.size() && jobs[job].first == idx; job++)
+                {
+                    for (size_t window = 0; window < sampleStats.size(); window++)
+                    {
+                        pcmStatsAdd(sampleStats[window], stats[job][window]);
+                    }
+                }
+
+                finishAnalysis(sampleStats, analysisPool[i]);
+
+                encoded.clear();
+                losslessAssemble(frames[idx], encoded);
+                frames[idx] = {};
+
+                spill.seekp(0, std::ios_base::end);
+                spillOffsets[i] = spill.tellp();
+                spill.write((str) encoded.data(), encoded.size());
+
+                layoutSamples[i].blocks    = encoded.size() / BLOCK_SIZE;
+                samplePool[i].storedBlocks = layoutSamples[i].blocks;
+
+                pPhase.samples++;
+                pPhase.bytesRead += (u64) blocksFor(sampleSourcePool[i].dataSize) * BLOCK_SIZE;
+                pPhase.bytesWritten += encoded.size();
+            }
+
+            if (!spill.good())
+            {
+                return SERR_SD_WRITE_ERROR;
+            }
+        }
+
+        return SERR_OK;
+    };
+
+    {
+        auto &phase = metrics.begin("encode");
+
+        // an instrument whose wavs are the same as in the last build keeps the sizes its samples had in that image, it
+        // is only encoded again if the layout moved and its pcm has to be rewritten after all
+        ImageManifest                    previous;
+        std::vector<sfsInstrumentSample> previousSamples;
+
+        std::error_code ec;
+        if (!pOptions.full && ImageManifest::load(manifestPath, previous) && !previous.instruments.empty() &&
+            std::filesystem::file_size(imagePath, ec) == previous.imageSize)
+        {
+            const auto &last = previous.instruments.back();
+            previousSamples.resize(last.sampleIdxOrigin + last.sampleCount);
+
+            std::ifstream previousImage(imagePath, std::ios_base::in | std::ios_base::binary);
+            previousImage.seekg((u64) previous.header.sampleInfoBlockStart * BLOCK_SIZE, std::ios_base::beg);
+            previousImage.read((str) previousSamples.data(), previousSamples.size() * sizeof(sfsInstrumentSample));
+
+            if (!previousImage.good())
+            {
+                previousSamples.clear();
+            }
+        }
+
+        for (size_t k = 0; !previousSamples.empty() && k < manifest.instruments.size() && k < previous.instruments.size(); k++)
+        {
+            const auto &instrument = manifest.instruments[k];
+            const auto &last       = previous.instruments[k];
+
+            if (instrument.id != last.id || instrument.pcmStamp != last.pcmStamp || instrument.sampleIdxOrigin != last.sampleIdxOrigin ||
+                instrument.sampleCount != last.sampleCount || instrument.sampleIdxOrigin + instrument.sampleCount > previousSamples.size())
+            {
+                continue;
+            }
+
+            for (u32 i = instrument.sampleIdxOrigin; i < instrument.sampleIdxOrigin + instrument.sampleCount; i++)
+            {
+                const auto &stored = previousSamples[i];
+                if (layoutSamples[i].owner == i && samplePool[i].encoding == SFS_SAMPLE_ENCODING_LOSSLESS &&
+                    stored.encoding == SFS_SAMPLE_ENCODING_LOSSLESS && stored.storedBlocks != 0)
+                {
+                    encodeSkipped[i]           = true;
+                    layoutSamples[i].blocks    = stored.storedBlocks;
+                    samplePool[i].storedBlocks = stored.storedBlocks;
+                }
+            }
+        }
+
+        std::vector<u32> encodedSamples;
+        size_t           skipped = 0;
+        for (u32 i = 0; i < samplePool.size(); i++)
+        {
+            if (layoutSamples[i].owner == i && samplePool[i].encoding == SFS_SAMPLE_ENCODING_LOSSLESS)
+            {
+                if (encodeSkipped[i])
+                {
+                    skipped++;
+                }
+                else
+                {
+                    encodedSamples.push_back(i);
+                }
+            }
+        }
+
+        synthErrno ret = encodeLossless(encodedSamples, phase);
+        if (ret != SERR_OK)
+        {
+            return ret;
+        }
+
+        // duplicates point at their owner's copy, so they take its size as well
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            u32 owner = layoutSamples[i].owner;
+
+            layoutSamples[i].blocks    = layoutSamples[owner].blocks;
+            samplePool[i].storedBlocks = samplePool[owner].storedBlocks;
+
+            if (owner != i)
+            {
+                dedupBytes += (size_t) layoutSamples[i].blocks * BLOCK_SIZE;
+            }
+        }
+
+        if (!encodedSamples.empty())
+        {
+            printf("\t- %zu lossless samples, %s of PCM compressed to %s (%.1f%% smaller).\n", encodedSamples.size(),
+                   bytesToStr(phase.bytesRead).c_str(), bytesToStr(phase.bytesWritten).c_str(),
+                   100.0 * (1.0 - (f64) phase.bytesWritten / phase.bytesRead));
+        }
+
+        if (skipped != 0)
+        {
+            printf("\t- %zu unchanged lossless samples keep the size they were encoded to in the last build.\n", skipped);
+        }
+    }
+
+    if (dedupCount != 0)
+    {
+        printf("\t- %zu samples share PCM with another sample, saved %s.\n", dedupCount, bytesToStr(dedupBytes).c_str());
+    }
+
+    metrics.counter("instruments", instrumentPaths.size());
+    metrics.counter("samples", samplePool.size());
+    metrics.counter("dedupSamples", dedupCount);
+    metrics.counter("dedupBytes", dedupBytes);
+
+    // pcm storage order, positions are only assigned in the layout pass since alignment depends on where pcm starts
+    metrics.begin("order");
+    if (pOptions.allocationUnit % BLOCK_SIZE != 0)
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    std::vector<u32> traceSamples;
+    if (pOptions.layout == PCM_LAYOUT_TRACE || (pOptions.residentBudget != 0 && !pOptions.trace.empty()))
+    {
+        std::vector<MidiNoteOn> notes;
+
+        synthErrno ret = MidiTrace::load(pOptions.trace, notes);
+        if (ret != SERR_OK)
+        {
+            return ret;
+        }
+
+        traceSamples = PcmLayout::traceSamples(notes, proximityTablePool.data(), proximityTablePool.size(), pOptions.traceInstrument);
+    }
+
+    std::vector<u32> pcmOrder = PcmLayout::order(pOptions.layout, layoutSamples, pOptions.layout == PCM_LAYOUT_TRACE ? traceSamples : std::vector<u32>());
+
+    // resident samples, weighed by how often the trace triggers them or without one by how many key and velocity
+    // slots of their instrument play them
+    std::vector<bool> resident(samplePool.size(), false);
+    if (pOptions.residentBudget != 0)
+    {
+        auto &phase = metrics.begin("resident");
+
+        std::vector<f64> triggers(samplePool.size(), 0);
+        if (!pOptions.trace.empty())
+        {
+            for (u32 sample: traceSamples)
+            {
+                triggers[layoutSamples[sample].owner]++;
+            }
+        }
+        else
+        {
+            for (const auto &table: proximityTablePool)
+            {
+                for (const auto &master: table.masterEntries)
+                {
+                    for (const auto &entry: master.byVelocity)
+                    {
+                        if (entry.velocity != SFS_INVALID_VELOCITY)
+                        {
+                            triggers[layoutSamples[table.sampleIdxOrigin + entry.sampleIdx].owner]++;
+                        }
+                    }
+                }
+            }
+        }
+
+        std::vector<ResidentCandidate> candidates;
+        for (u32 i = 0; i < samplePool.size(); i++)
+        {
+            if (layoutSamples[i].owner == i)
+            {
+                candidates.push_back({i, layoutSamples[i].blocks, triggers[i]});
+            }
+        }
+
+        auto plan = ResidentPlan::plan(candidates, std::min<u64>(pOptions.residentBudget / BLOCK_SIZE, std::numeric_limits<u32>::max()));
+        for (u32 sample: plan.samples)
+        {
+            resident[sample] = true;
+        }
+
+        phase.samples = plan.samples.size();
+
+        printf("\t- %zu resident samples take %s of the %s budget and serve %.1f%% of the expected triggers.\n", plan.samples.size(),
+               bytesToStr(plan.blocks * BLOCK_SIZE).c_str(), bytesToStr(pOptions.residentBudget).c_str(),
+               plan.allTriggers > 0 ? 100.0 * plan.triggers / plan.allTriggers : 0.0);
+    }
+
+    u32 instrumentCount = singleInstrumentCount + multiInstrumentCount;
+
+    // hold behaviours
+    metrics.begin("hold");
+    std::vector<std::vector<sfsHoldBehaviour> > holdBehaviours(singleInstrumentCount);
+    {
+        sfsHoldBehaviour dummyHold = {};
+        dummyHold.instrumentId     = SFS_INVALID_INSTRUMENT_ID;
+
+        for (size_t i = 0; i < singleInstrumentCount; i++)
+        {
+            holdBehaviours[i] = std::vector(1, dummyHold);
+        }
+
+        size_t holdBehaviourCount = 0;
+
+        nlohmann::json holdJson = loadJson("instruments/hold.json");
+        if (holdJson != nullptr)
+        {
+            // the ids are taken before parsing, a behaviour naming an unknown instrument must not become matchable
+            std::vector<std::pair<std::string, u16> > instrumentIds(mapInstrumentStringIdToNumId.begin(), mapInstrumentStringIdToNumId.end());
+
+            PatternMatcher                                matcher;
+            std::vector<std::vector<sfsHoldBehaviour> > keyBehaviours;
+
+            for (auto it = holdJson.begin(); it != holdJson.end(); ++it)
+            {
+                auto key = it.key();
 
                 auto behavioursJson = holdJson[key];
                 if (behavioursJson.size() > holdBehaviourCount)
@@ -431,195 +1151,740 @@ synthErrno SynthFs::writeImage(std::filesystem::path pInstrumentsFolder) {
                     behaviourVector.push_back(behaviourObj);
                 }
 
-                auto keyRegex = std::regex(key);
-                for (const auto &instrumentStrId: mapInstrumentStringIdToNumId | std::views::keys)
+                matcher.add(key);
+                keyBehaviours.push_back(std::move(behaviourVector));
+            }
+
+            // one pass per instrument over all keys at once, later keys still win over earlier ones
+            std::vector<std::vector<std::string> > matchedIds(matcher.size());
+            std::vector<u32>                       matches;
+
+            for (const auto &[instrumentStrId, instrumentNumId]: instrumentIds)
+            {
+                matcher.match(instrumentStrId, matches);
+                if (matches.empty() || instrumentNumId >= singleInstrumentCount)
+                {
+                    continue;
+                }
+
+                for (u32 keyIdx: matches)
                 {
-                    if (std::regex_match(instrumentStrId, keyRegex))
-                    {
-                        auto instrumentNumId = mapInstrumentStringIdToNumId[instrumentStrId];
-                        for (size_t i = 0; i < behaviourVector.size(); i++)
-                        {
-                            auto elem = behaviourVector[i];
-                            if (elem.instrumentId == instrumentNumId)
-                            {
-                                behaviourVector.erase(behaviourVector.begin() + i);
-                            }
-                        }
+                    matchedIds[keyIdx].push_back(instrumentStrId);
+                }
 
-                        holdBehaviours[instrumentNumId] = behaviourVector;
-                    }
+                // an instrument never holds into itself
+                auto &behaviours = holdBehaviours[instrumentNumId];
+                behaviours       = keyBehaviours[matches.back()];
+                std::erase_if(behaviours, [&](const sfsHoldBehaviour &pBehaviour) {
+                    return pBehaviour.instrumentId == instrumentNumId;
+                });
+            }
+
+            for (size_t i = 0; i < matcher.size(); i++)
+            {
+                if (matchedIds[i].empty())
+                {
+                    printf("\t- Warning: hold.json key \"%s\" matches no instrument\n", matcher.pattern(i).c_str());
+                    continue;
                 }
+
+                std::string ids;
+                for (const auto &id: matchedIds[i])
+                {
+                    ids += (ids.empty() ? "" : ", ") + id;
+                }
+
+                printf("\t- Hold \"%s\"%s -> %s\n", matcher.pattern(i).c_str(), matcher.isFallback(i) ? " (std::regex)" : "", ids.c_str());
             }
 
             holdBehaviourCount++;
 
-            for (size_t i = 0; i < singleInstrumentCount; i++)
+            // every row gets the same length, the image header records it so readers can index rows
+            for (auto &behaviours: holdBehaviours)
             {
-                auto &behaviours = holdBehaviours[i];
                 behaviours.insert(behaviours.begin(), dummyHold);
+                holdBehaviourCount = std::max(holdBehaviourCount, behaviours.size());
+            }
 
-                auto remaining = holdBehaviourCount - behaviours.size();
-                for (size_t j = 0; j < remaining; ++j)
+            for (auto &behaviours: holdBehaviours)
+            {
+                behaviours.resize(holdBehaviourCount, dummyHold);
+            }
+        }
+
+        // hold.json feeds no instrument's metaHash, the rows it resolved to are hashed for the whole image instead
+        manifest.holdHash = HASH_FNV1A_SEED;
+        for (const auto &behaviours: holdBehaviours)
+        {
+            manifest.holdHash = hashFnv1a(behaviours.data(), behaviours.size() * sizeof(sfsHoldBehaviour), manifest.holdHash);
+        }
+    }
+
+    // layout pass: every section's position follows from the pools and the wav header sizes alone, so the header is
+    // known before a single pcm byte is read
+    sfsHeader       header = {};
+    std::vector<u8> compactProximity; // the section of a SFS_PROXIMITY_COMPACT image
+
+    header.magic = SFS_MAGIC;
+    {
+        auto &phase = metrics.begin("layout");
+        size_t holdBehaviourBytes = 0;
+        for (const auto &behaviours: holdBehaviours)
+        {
+            holdBehaviourBytes += behaviours.size() * sizeof(sfsHoldBehaviour);
+        }
+
+        size_t stringDataBytes = 0;
+        for (const auto &name: namePool)
+        {
+            stringDataBytes += name.length() + 1;
+        }
+
+        u32 blk = 1;
+
+        header.holdBehaviorDataStart = blk;
+        blk += blocksFor(holdBehaviourBytes);
+
+        std::vector<u32> pcmOffsets, residentOffsets, residentOrder, streamedOrder;
+        u32              pcmPaddingBlocks, residentPaddingBlocks;
+
+        // resident samples open the pcm data, packed without alignment so the device loads them in one read
+        for (u32 sample: pcmOrder)
+        {
+            (resident[sample] ? residentOrder : streamedOrder).push_back(sample);
+        }
+
+        header.pcmDataBlockStart = blk;
+        blk = PcmLayout::place(residentOrder, layoutSamples, blk, 0, residentOffsets, residentPaddingBlocks);
+
+        if (blk != header.pcmDataBlockStart)
+        {
+            header.residentRegionBlockStart = header.pcmDataBlockStart;
+            header.residentRegionBlockCount = blk - header.pcmDataBlockStart;
+        }
+
+        blk = PcmLayout::place(streamedOrder, layoutSamples, blk, pOptions.allocationUnit / BLOCK_SIZE, pcmOffsets, pcmPaddingBlocks);
+
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            samplePool[i].pcmDataBlockOffset = resident[layoutSamples[i].owner] ? residentOffsets[i] : pcmOffsets[i];
+        }
+
+        phase.samples      = pcmOrder.size();
+        phase.paddingBytes = (u64) pcmPaddingBlocks * BLOCK_SIZE;
+
+        if (pcmPaddingBlocks != 0)
+        {
+            printf("\t- Allocation unit alignment added %s of padding.\n", bytesToStr((size_t) pcmPaddingBlocks * BLOCK_SIZE).c_str());
+        }
+
+        header.stringLutBlockStart = blk;
+        blk += blocksFor(namePool.size() * sizeof(u32));
+
+        header.stringDataBlockStart = blk;
+        blk += blocksFor(stringDataBytes);
+
+        header.instrumentInfoDataBlockStart = blk;
+        blk += blocksFor(singleInstrumentPool.size() * sizeof(sfsSingleInstrument));
+
+        header.sampleInfoBlockStart = blk;
+        blk += blocksFor(samplePool.size() * sizeof(sfsInstrumentSample));
+
+        if (pOptions.proximity == SFS_PROXIMITY_COMPACT)
+        {
+            compactProximity = ProximityTable::compactSection(proximityTablePool);
+        }
+
+        header.proximityTableEncoding   = pOptions.proximity;
+        header.proximityTableBlockStart = blk;
+        blk += blocksFor(pOptions.proximity == SFS_PROXIMITY_COMPACT ? compactProximity.size()
+                                                                       : proximityTablePool.size() * sizeof(sfsKeyProximityTable));
+
+        // the attack region holds one copy per stored sample, as many blocks as the most demanding sample sharing it
+        // asked for. it is copied out of the pcm once that is on disk
+        std::vector<u32> attackBlocks(samplePool.size(), 0);
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            s32 requested = ingestedInstruments[layoutSamples[i].instrumentIdx].attackBlocks;
+            u32 blocks    = requested >= 0 ? (u32) requested : pOptions.attackBlocks;
+            u32 owner     = layoutSamples[i].owner;
+
+            // a resident sample is in ram as a whole already
+            if (resident[owner])
+            {
+                continue;
+            }
+
+            blocks              = std::min<u32>(std::min<u32>(blocks, SFS_MAX_ATTACK_BLOCKS), layoutSamples[owner].blocks);
+            attackBlocks[owner] = std::max(attackBlocks[owner], blocks);
+        }
+
+        u32 attackRegionBlocks = 0;
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            if (layoutSamples[i].owner == i && attackBlocks[i] != 0)
+            {
+                samplePool[i].attackBlockOffset = blk + attackRegionBlocks;
+                samplePool[i].attackBlocks      = attackBlocks[i];
+                attackRegionBlocks += attackBlocks[i];
+            }
+        }
+
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            u32 owner = layoutSamples[i].owner;
+
+            samplePool[i].attackBlockOffset = samplePool[owner].attackBlockOffset;
+            samplePool[i].attackBlocks      = samplePool[owner].attackBlocks;
+        }
+
+        if (attackRegionBlocks != 0)
+        {
+            header.attackRegionBlockStart = blk;
+            header.attackRegionBlockCount = attackRegionBlocks;
+            blk += attackRegionBlocks;
+        }
+
+        // filled in once everything before it is on disk
+        if (pOptions.crcExtentBlocks != 0)
+        {
+            header.crcTableBlockStart = blk;
+            header.crcExtentBlocks    = pOptions.crcExtentBlocks;
+            blk += blocksFor((size_t) sfsCrcExtentCount(header) * sizeof(u32));
+        }
+
+        header.instrumentCount       = instrumentCount;
+        header.singleInstrumentCount = singleInstrumentCount;
+        header.multiInstrumentCount  = multiInstrumentCount;
+        header.holdBehaviourStride   = holdBehaviours.empty() ? 0 : holdBehaviours[0].size();
+
+        for (auto &instrument: manifest.instruments)
+        {
+            instrument.layoutHash = HASH_FNV1A_SEED;
+            instrument.blockStart = header.pcmDataBlockStart;
+            instrument.blockCount = 0;
+
+            for (u32 i = instrument.sampleIdxOrigin; i < instrument.sampleIdxOrigin + instrument.sampleCount; i++)
+            {
+                instrument.layoutHash = hashFnv1aValue(samplePool[i].pcmDataBlockOffset, instrument.layoutHash);
+                instrument.layoutHash = hashFnv1aValue(layoutSamples[i].blocks, instrument.layoutHash);
+
+                if (layoutSamples[i].owner == i)
                 {
-                    behaviours.push_back(dummyHold);
+                    u32 offset            = samplePool[i].pcmDataBlockOffset;
+                    instrument.blockStart = instrument.blockCount == 0 ? offset : std::min(instrument.blockStart, offset);
+                    instrument.blockCount += layoutSamples[i].blocks;
                 }
             }
         }
 
-        header.holdBehaviorDataStart = obpos(sfsImgOut);
-
-        for (size_t i = 0; i < singleInstrumentCount; i++)
+        manifest.header    = header;
+        manifest.imageSize = (u64) blk * BLOCK_SIZE;
+    }
+
+    // incremental rebuild: with the same layout as the last build only instruments whose wavs changed need their pcm
+    // rewritten, the metadata sections are small and always rewritten in place
+    auto &manifestPhase = metrics.begin("manifest");
+
+    ImageManifest     previous;
+    std::vector<bool> pcmDirty(samplePool.size(), true);
+    bool              upToDate = false;
+
+    std::error_code ec;
+    bool            incremental = !pOptions.full && ImageManifest::load(manifestPath, previous);
+
+    incremental = incremental && manifest.sameLayout(previous) && std::filesystem::file_size(imagePath, ec) == previous.imageSize;
+
+    if (incremental)
+    {
+        // the amplitudes of untouched samples are only known from the previous image
+        std::ifstream                    previousImage(imagePath, std::ios_base::in | std::ios_base::binary);
+        std::vector<sfsInstrumentSample> previousSamples(samplePool.size());
+
+        previousImage.seekg((u64) header.sampleInfoBlockStart * BLOCK_SIZE, std::ios_base::beg);
+        previousImage.read((str) previousSamples.data(), previousSamples.size() * sizeof(sfsInstrumentSample));
+
+        incremental             = previousImage.good();
+        manifestPhase.bytesRead = previousSamples.size() * sizeof(sfsInstrumentSample);
+
+        size_t dirtyInstruments = 0, metaChanged = 0;
+        for (size_t i = 0; incremental && i < manifest.instruments.size(); i++)
+        {
+            const auto &instrument = manifest.instruments[i];
+            bool        dirty      = instrument.pcmStamp != previous.instruments[i].pcmStamp;
+
+            dirtyInstruments += dirty;
+            metaChanged += instrument.metaHash != previous.instruments[i].metaHash;
+
+            for (u32 j = instrument.sampleIdxOrigin; j < instrument.sampleIdxOrigin + instrument.sampleCount; j++)
+            {
+                pcmDirty[j] = dirty;
+                if (!dirty)
+                {
+                    samplePool[j].startAverageAmplitude = previousSamples[j].startAverageAmplitude;
+                    samplePool[j].endAverageAmplitude   = previousSamples[j].endAverageAmplitude;
+                }
+            }
+        }
+
+        // the metadata sections only depend on the layout, hold.json and what metaHash covers, so with none of them
+        // and no pcm changed the image on disk is already what this build would write
+        upToDate = incremental && dirtyInstruments == 0 && metaChanged == 0 && manifest.holdHash == previous.holdHash;
+
+        if (upToDate)
+        {
+            printf("\nLayout, PCM and metadata unchanged, the image is up to date.\n");
+        }
+        else if (incremental)
+        {
+            printf("\nLayout unchanged, rewriting PCM of %zu / %zu instruments.\n", dirtyInstruments, manifest.instruments.size());
+        }
+        else
+        {
+            pcmDirty.assign(pcmDirty.size(), true);
+        }
+    }
+
+    metrics.counter("incremental", incremental);
+
+    auto saveMetrics = [&]() {
+        metrics.counter("imageBytes", manifest.imageSize);
+        if (!pOptions.metrics.empty() && !metrics.save(pOptions.metrics))
+        {
+            printf("Could not write build metrics to %s.\n", pOptions.metrics.string().c_str());
+        }
+    };
+
+    if (upToDate)
+    {
+        saveMetrics();
+        return SERR_OK;
+    }
+
+    // unchanged lossless samples were laid out with their previous size, which their pcm has to be rewritten at
+    // after all when the layout moved
+    {
+        std::vector<u32> reencoded;
+        for (u32 i = 0; i < samplePool.size(); i++)
+        {
+            if (encodeSkipped[i] && pcmDirty[i])
+            {
+                reencoded.push_back(i);
+            }
+        }
+
+        if (!reencoded.empty())
+        {
+            std::vector<u32> previousBlocks;
+            for (u32 i: reencoded)
+            {
+                previousBlocks.push_back(layoutSamples[i].blocks);
+            }
+
+            synthErrno ret = encodeLossless(reencoded, metrics.begin("reencode"));
+            if (ret != SERR_OK)
+            {
+                return ret;
+            }
+
+            for (size_t k = 0; k < reencoded.size(); k++)
+            {
+                if (layoutSamples[reencoded[k]].blocks != previousBlocks[k])
+                {
+                    printf("Sample %u no longer encodes to its size in the last build, rebuild with --full.\n", reencoded[k]);
+                    return SERR_SFS_INVALID_IMAGE;
+                }
+            }
+        }
+    }
+
+    ImageWriterOptions writerOptions = {};
+    writerOptions.direct             = pOptions.direct;
+    writerOptions.truncate           = !incremental;
+    writerOptions.size               = manifest.imageSize;
+
+    ImageWriter sfsImgOut;
+    if (!sfsImgOut.open(imagePath, writerOptions))
+    {
+        return SERR_SD_WRITE_ERROR;
+    }
+
+    // a build that dies halfway must not leave a manifest vouching for the old contents
+    std::filesystem::remove(manifestPath, ec);
+
+    sfsImgOut.seek(BLOCK_SIZE * 1);
+    printf("\nWriting file%s: \n", sfsImgOut.isDirect() ? " (unbuffered)" : "");
+
+    // an image rewritten in place still holds the last build's bytes, a shorter sample or section must not leave
+    // them behind in its last block, so the rest of the block is written as zeros instead of skipped
+    auto padBlock = [&]() {
+        u64 tail = roundUpTo(sfsImgOut.tell(), BLOCK_SIZE) - sfsImgOut.tell();
+        if (incremental && tail != 0)
+        {
+            static const u8 zeros[BLOCK_SIZE] = {};
+            sfsImgOut.write(zeros, tail);
+        }
+
+        sfsImgOut.pad(BLOCK_SIZE);
+    };
+
+    // a section's own bytes, then the zeros up to its last block
+    auto padSection = [&](BuildPhaseMetrics &pPhase, u64 pStart) {
+        pPhase.bytesWritten = sfsImgOut.tell() - pStart;
+        padBlock();
+        pPhase.paddingBytes = sfsImgOut.tell() - pStart - pPhase.bytesWritten;
+    };
+
+    // hold behaviours
+    {
+        printf("\t- Writing hold behaviour data...\n");
+        size_t p0    = sfsImgOut.tell();
+        auto  &phase = metrics.begin("write.hold");
+
+        for (size_t i = 0; i < singleInstrumentCount; i++)
+        {
+            auto &behaviours = holdBehaviours[i];
+
+            sfsImgOut.write(behaviours.data(), behaviours.size() * sizeof(sfsHoldBehaviour));
+        }
+
+        padSection(phase, p0);
+
+        printf("\t- Written %s of hold behaviour data.\n\t- - - - - - - - - - -\n", bytesToStr((size_t) sfsImgOut.tell() - p0).c_str());
+    }
+
+    // pcm data
+    {
+        printf("\t- Writing PCM data...\n");
+        auto &phase = metrics.begin("write.pcm");
+
+        size_t written = 0;
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            auto &sample = samplePool[i];
+            if (!pcmDirty[i] || layoutSamples[i].owner != i)
+            {
+                continue;
+            }
+
+            sfsImgOut.seek((u64) sample.pcmDataBlockOffset * BLOCK_SIZE);
+
+            // lossless samples were encoded and measured ahead of the layout, only their spilled frames are copied
+            auto      &analysis = analysisPool[i];
+            synthErrno ret      = sample.encoding == SFS_SAMPLE_ENCODING_LOSSLESS
+                                      ? copySpilled(sfsImgOut, spill, spillOffsets[i], (u64) layoutSamples[i].blocks * BLOCK_SIZE)
+                                      : streamSamplePcm(sfsImgOut, sampleSourcePool[i], sample.encoding, analysis);
+            if (ret != SERR_OK)
+            {
+                return ret;
+            }
+
+            sample.startAverageAmplitude = analysis.startMeanAbs;
+            sample.endAverageAmplitude   = analysis.endMeanAbs;
+
+            padBlock();
+
+            // encoded blocks are full by definition, only raw pcm pads its last block
+            u64 storedBytes = (u64) layoutSamples[i].blocks * BLOCK_SIZE;
+            u64 dataBytes   = sample.encoding == SFS_SAMPLE_ENCODING_PCM16 ? sampleSourcePool[i].dataSize : storedBytes;
+
+            written += storedBytes;
+
+            // analysis runs fused with the copy since there is no separate pass to time, samples counts what it saw
+            phase.samples++;
+            phase.bytesRead += sample.encoding == SFS_SAMPLE_ENCODING_LOSSLESS ? storedBytes : sampleSourcePool[i].dataSize;
+            phase.bytesWritten += dataBytes;
+            phase.paddingBytes += storedBytes - dataBytes;
+        }
+
+        if (spill.is_open())
+        {
+            spill.close();
+            std::filesystem::remove(spillPath, ec);
+        }
+
+        size_t clipping = 0, offset = 0;
+        for (size_t i = 0; i < samplePool.size(); i++)
         {
-            auto behaviours = holdBehaviours[i];
+            u32 owner = layoutSamples[i].owner;
 
-            for (auto behaviour: behaviours)
+            samplePool[i].startAverageAmplitude = samplePool[owner].startAverageAmplitude;
+            samplePool[i].endAverageAmplitude   = samplePool[owner].endAverageAmplitude;
+            analysisPool[i]                     = analysisPool[owner];
+
+            const auto &analysis = analysisPool[i];
+            if (analysis.valid && owner == i)
             {
-                auto ptr = (str) &behaviour;
-                sfsImgOut.write(ptr, sizeof(sfsHoldBehaviour));
+                clipping += analysis.peak >= SFS_ANALYSIS_CLIP_LEVEL;
+                offset += abs(analysis.dcOffset) > SFS_ANALYSIS_DC_LIMIT;
+
+                const auto &layout = layoutSamples[i];
+                auto        name   = std::format("{}/{}_{}", instrumentPaths[layout.instrumentIdx].filename().string(), layout.semitone, layout.velocity);
+
+                metrics.sample({name, analysis.startMeanAbs, analysis.endMeanAbs, analysis.startRms, analysis.endRms, analysis.peak, analysis.dcOffset});
             }
         }
 
-        padStream(sfsImgOut, BLOCK_SIZE);
-
-        printf("\t- Written %s of hold behaviour data.\n\t- - - - - - - - - - -\n", bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
-    }
+        printf("\t- Written %s of PCM data.\n", bytesToStr(written).c_str());
+        if (clipping || offset)
+        {
+            printf("\t- %zu samples reach full scale, %zu have a DC offset above %d.\n", clipping, offset, SFS_ANALYSIS_DC_LIMIT);
+        }
 
-    // pcm data
-    {
-        printf("\t- Writing PCM data...\n");
-        size_t p0 = sfsImgOut.tellp();
+        // the worst encoded sample is the one to listen to first
+        AdpcmError codecTotal = {};
+        size_t     encoded    = 0;
+        size_t     worst      = 0;
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            const auto &error = analysisPool[i].codecError;
+            if (!analysisPool[i].valid || layoutSamples[i].owner != i || samplePool[i].encoding != SFS_SAMPLE_ENCODING_ADPCM)
+            {
+                continue;
+            }
 
-        auto pcmStart            = obpos(sfsImgOut);
-        header.pcmDataBlockStart = pcmStart;
+            if (encoded == 0 || error.snr() < analysisPool[worst].codecError.snr())
+            {
+                worst = i;
+            }
 
-        for (auto &sample: samplePool)
-        {
-            sample.pcmDataBlockOffset += pcmStart;
+            encoded++;
+            codecTotal.count += error.count;
+            codecTotal.signalSquares += error.signalSquares;
+            codecTotal.errorSquares += error.errorSquares;
+            codecTotal.peak = std::max(codecTotal.peak, error.peak);
         }
 
-        for (auto pcm: sampleDataPool)
+        if (encoded != 0)
         {
-            sfsImgOut.write((str) pcm.data(), pcm.size());
-            padStream(sfsImgOut, BLOCK_SIZE);
+            const auto &worstSample = samplePool[worst];
+            printf("\t- %zu ADPCM samples, SNR %.1f dB overall, worst %.1f dB (%s %u_%u), peak error %u.\n", encoded, codecTotal.snr(),
+                   analysisPool[worst].codecError.snr(), instrumentPaths[layoutSamples[worst].instrumentIdx].filename().string().c_str(),
+                   (u32) worstSample.pitchSemitones, (u32) worstSample.velocity, codecTotal.peak);
         }
 
-        printf("\t- Written %s of PCM data.\n\t- - - - - - - - - - -\n", bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
+        printf("\t- - - - - - - - - - -\n");
     }
 
     // string LUT
     {
         printf("\t- Writing string LUT data...\n");
-        size_t p0 = sfsImgOut.tellp();
-
-        auto lutStart              = obpos(sfsImgOut);
-        header.stringLutBlockStart = lutStart;
+        sfsImgOut.seek((u64) header.stringLutBlockStart * BLOCK_SIZE);
+        size_t p0    = sfsImgOut.tell();
+        auto  &phase = metrics.begin("write.stringLut");
 
         u32 offset = 0;
         for (const auto &name: namePool)
         {
-            sfsImgOut.write((str) &offset, sizeof(u32));
+            sfsImgOut.write(&offset, sizeof(u32));
             offset += name.length() + 1;
         }
 
-        padStream(sfsImgOut, BLOCK_SIZE);
+        padSection(phase, p0);
 
         printf("\t- Written %s of string LUT data.\n\t- - - - - - - - - - -\n",
-               bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
+               bytesToStr((size_t) sfsImgOut.tell() - p0).c_str());
     }
 
     // string data
     {
         printf("\t- Writing string data...\n");
-        size_t p0 = sfsImgOut.tellp();
-
-        auto strDataStart           = obpos(sfsImgOut);
-        header.stringDataBlockStart = strDataStart;
+        sfsImgOut.seek((u64) header.stringDataBlockStart * BLOCK_SIZE);
+        size_t p0    = sfsImgOut.tell();
+        auto  &phase = metrics.begin("write.strings");
 
         for (const auto &name: namePool)
         {
             sfsImgOut.write(name.data(), name.length() + 1);
         }
 
-        padStream(sfsImgOut, BLOCK_SIZE);
+        padSection(phase, p0);
 
         printf("\t- Written %s of string data.\n\t- - - - - - - - - - -\n",
-               bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
+               bytesToStr((size_t) sfsImgOut.tell() - p0).c_str());
     }
 
     // sfsSingleInstrument data
     {
         printf("\t- Writing instrument info data...\n");
-        size_t p0 = sfsImgOut.tellp();
-
-        auto instrumentInfoStart            = obpos(sfsImgOut);
-        header.instrumentInfoDataBlockStart = instrumentInfoStart;
+        sfsImgOut.seek((u64) header.instrumentInfoDataBlockStart * BLOCK_SIZE);
+        size_t p0    = sfsImgOut.tell();
+        auto  &phase = metrics.begin("write.instruments");
 
         for (const auto &instrument: singleInstrumentPool)
         {
-            sfsImgOut.write((str) &instrument, sizeof(sfsSingleInstrument));
+            sfsImgOut.write(&instrument, sizeof(sfsSingleInstrument));
         }
 
-        padStream(sfsImgOut, BLOCK_SIZE);
+        padSection(phase, p0);
 
         printf("\t- Written %s of instrument info data.\n\t- - - - - - - - - - -\n",
-               bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
+               bytesToStr((size_t) sfsImgOut.tell() - p0).c_str());
     }
 
-    // sfsSingleSample data
+    // sfsSingleSample data, written after the pcm so the amplitudes measured while streaming are in
     {
         printf("\t- Writing sample info data...\n");
-        size_t p0 = sfsImgOut.tellp();
-
-        auto sampleInfoStart        = obpos(sfsImgOut);
-        header.sampleInfoBlockStart = sampleInfoStart;
+        sfsImgOut.seek((u64) header.sampleInfoBlockStart * BLOCK_SIZE);
+        size_t p0    = sfsImgOut.tell();
+        auto  &phase = metrics.begin("write.samples");
 
         for (const auto &sample: samplePool)
         {
-            sfsImgOut.write((str) &sample, sizeof(sfsInstrumentSample));
+            sfsImgOut.write(&sample, sizeof(sfsInstrumentSample));
         }
 
-        padStream(sfsImgOut, BLOCK_SIZE);
+        padSection(phase, p0);
 
         printf("\t- Written %s of sample info data.\n\t- - - - - - - - - - -\n",
-               bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
+               bytesToStr((size_t) sfsImgOut.tell() - p0).c_str());
     }
 
     // proximityTableBlockStart data
     {
         printf("\t- Writing proximity tables...\n");
-        size_t p0 = sfsImgOut.tellp();
+        sfsImgOut.seek((u64) header.proximityTableBlockStart * BLOCK_SIZE);
+        size_t p0    = sfsImgOut.tell();
+        auto  &phase = metrics.begin("write.proximity");
+
+        if (header.proximityTableEncoding == SFS_PROXIMITY_COMPACT)
+        {
+            sfsImgOut.write(compactProximity.data(), compactProximity.size());
+        }
+        else
+        {
+            for (const auto &table: proximityTablePool)
+            {
+                sfsImgOut.write(&table, sizeof(sfsKeyProximityTable));
+            }
+        }
+
+        padSection(phase, p0);
+
+        printf("\t- Written %s of %s proximity tables.\n\t- - - - - - - - - - -\n", bytesToStr((size_t) sfsImgOut.tell() - p0).c_str(),
+               ProximityTable::encodingName((sfsProximityEncoding) header.proximityTableEncoding));
+    }
+
+    printf("\t- Writing header...\n");
+    auto &headerPhase = metrics.begin("write.header");
+
+    sfsImgOut.seek(0);
+    sfsImgOut.write(&header, sizeof(header));
+
+    headerPhase.bytesWritten = sizeof(header);
+
+    printf("\t- Written %s header.\n\t- - - - - - - - - - -\n", bytesToStr(sfsImgOut.tell()).c_str());
+
+
+    // the last staged bytes only reach the file here
+    metrics.begin("close");
+
+    if (!sfsImgOut.close())
+    {
+        return SERR_SD_WRITE_ERROR;
+    }
+
+    // attack region, copied from the pcm on disk so an incremental build refreshes the copies of untouched samples too
+    if (header.attackRegionBlockCount != 0)
+    {
+        auto &phase = metrics.begin("attack");
+
+        std::vector<u8> region((size_t) header.attackRegionBlockCount * BLOCK_SIZE);
+        std::ifstream   in(imagePath, std::ios_base::in | std::ios_base::binary);
+        for (size_t i = 0; i < samplePool.size(); i++)
+        {
+            const auto &sample = samplePool[i];
+            if (layoutSamples[i].owner != i || sample.attackBlocks == 0)
+            {
+                continue;
+            }
+
+            in.seekg((u64) sample.pcmDataBlockOffset * BLOCK_SIZE, std::ios_base::beg);
+            in.read((str) region.data() + (size_t) (sample.attackBlockOffset - header.attackRegionBlockStart) * BLOCK_SIZE,
+                    (size_t) sample.attackBlocks * BLOCK_SIZE);
+            phase.samples++;
+        }
+
+        if (!in.good())
+        {
+            return SERR_SD_READ_ERROR;
+        }
+
+        in.close();
+
+        ImageWriterOptions attackOptions = {};
+        attackOptions.direct             = pOptions.direct;
+        attackOptions.truncate           = false;
+        attackOptions.size               = manifest.imageSize;
 
-        auto proximityTableStart        = obpos(sfsImgOut);
-        header.proximityTableBlockStart = proximityTableStart;
+        ImageWriter attackOut;
+        if (!attackOut.open(imagePath, attackOptions))
+        {
+            return SERR_SD_WRITE_ERROR;
+        }
 
-        for (const auto &table: proximityTablePool)
+        attackOut.seek((u64) header.attackRegionBlockStart * BLOCK_SIZE);
+        attackOut.write(region.data(), region.size());
+
+        if (!attackOut.close())
         {
-            sfsImgOut.write((str) &table, sizeof(sfsKeyProximityTable));
+            return SERR_SD_WRITE_ERROR;
         }
 
-        padStream(sfsImgOut, BLOCK_SIZE);
+        phase.bytesRead    = region.size();
+        phase.bytesWritten = region.size();
 
-        printf("\t- Written %s of proximity tables.\n\t- - - - - - - - - - -\n",
-               bytesToStr((size_t) sfsImgOut.tellp() - p0).c_str());
+        printf("\t- Copied the first blocks of %zu samples to a %s attack region.\n", (size_t) phase.samples,
+               bytesToStr(region.size()).c_str());
     }
 
-    auto end = sfsImgOut.tellp();
+    // crc table, read back from the file since an incremental build never had the untouched pcm in memory
+    if (header.crcTableBlockStart != 0)
+    {
+        auto &phase = metrics.begin("crc");
+
+        std::vector<u32> crcs;
+        synthErrno       ret = ImageChecksum::compute(imagePath, header.crcTableBlockStart, header.crcExtentBlocks, pOptions.jobs, crcs);
+        if (ret != SERR_OK)
+        {
+            return ret;
+        }
 
-    header.instrumentCount       = instrumentCount;
-    header.singleInstrumentCount = singleInstrumentCount;
-    header.multiInstrumentCount  = multiInstrumentCount;
+        ImageWriterOptions crcOptions = {};
+        crcOptions.direct             = pOptions.direct;
+        crcOptions.truncate           = false;
+        crcOptions.size               = manifest.imageSize;
 
-    printf("\t- Writing header...\n");
+        ImageWriter crcOut;
+        if (!crcOut.open(imagePath, crcOptions))
+        {
+            return SERR_SD_WRITE_ERROR;
+        }
+
+        crcOut.seek((u64) header.crcTableBlockStart * BLOCK_SIZE);
+        crcOut.write(crcs.data(), crcs.size() * sizeof(u32));
+        crcOut.pad(BLOCK_SIZE);
+
+        if (!crcOut.close())
+        {
+            return SERR_SD_WRITE_ERROR;
+        }
 
-    sfsImgOut.seekp(0, std::ios_base::beg);
-    sfsImgOut.write((str) &header, sizeof(header));
+        phase.bytesRead    = (u64) header.crcTableBlockStart * BLOCK_SIZE;
+        phase.bytesWritten = crcs.size() * sizeof(u32);
 
-    printf("\t- Written %s header.\n\t- - - - - - - - - - -\n", bytesToStr(sfsImgOut.tellp()).c_str());
+        printf("\t- Checksummed %zu extents of %u blocks%s.\n", crcs.size(), (u32) header.crcExtentBlocks,
+               crc32cAccelerated() ? "" : " (no crc instructions)");
+    }
 
-    printf("\nWritten %s file.\n", bytesToStr(end).c_str());
+    if (!manifest.save(manifestPath))
+    {
+        return SERR_SD_WRITE_ERROR;
+    }
 
-    sfsImgOut.close();
+    printf("\nWritten %s file.\n", bytesToStr(manifest.imageSize).c_str());
 
+    saveMetrics();
     return SERR_OK;
 }
 
@@ -658,6 +1923,153 @@ synthErrno SynthFs::flashImage() {
     return (synthErrno) system(cmd);
 }
 
+synthErrno SynthFs::inspectImage(const std::filesystem::path &pImage) {
+    SfsImage   image;
+    synthErrno ret = image.open(pImage);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    const auto &header = image.header();
+
+    printf("Image %s, %s:\n", pImage.string().c_str(), bytesToStr(image.size()).c_str());
+    printf("\t- Hold behaviours at block %u, %u per instrument\n", (u32) header.holdBehaviorDataStart, (u32) header.holdBehaviourStride);
+    printf("\t- PCM data at block %u\n", (u32) header.pcmDataBlockStart);
+    if (header.residentRegionBlockCount != 0)
+    {
+        u32 residentSamples = 0;
+        for (const auto &sample: image.samples())
+        {
+            residentSamples += sfsSampleIsResident(header, sample);
+        }
+
+        printf("\t- Resident region at block %u, %u blocks (%s) of %u samples\n", (u32) header.residentRegionBlockStart,
+               (u32) header.residentRegionBlockCount, bytesToStr((size_t) header.residentRegionBlockCount * BLOCK_SIZE).c_str(), residentSamples);
+    }
+    printf("\t- String LUT at block %u, string data at block %u\n", (u32) header.stringLutBlockStart, (u32) header.stringDataBlockStart);
+    printf("\t- Instrument info at block %u\n", (u32) header.instrumentInfoDataBlockStart);
+    printf("\t- Sample info at block %u, %zu samples\n", (u32) header.sampleInfoBlockStart, image.samples().size());
+    printf("\t- Proximity tables at block %u, %s, %s\n", (u32) header.proximityTableBlockStart,
+           ProximityTable::encodingName((sfsProximityEncoding) header.proximityTableEncoding), bytesToStr(image.proximityTableBytes()).c_str());
+    if (header.attackRegionBlockCount != 0)
+    {
+        printf("\t- Attack region at block %u, %u blocks (%s)\n", (u32) header.attackRegionBlockStart, (u32) header.attackRegionBlockCount,
+               bytesToStr((size_t) header.attackRegionBlockCount * BLOCK_SIZE).c_str());
+    }
+
+    printf("\nInstruments:\n");
+
+    auto instruments = image.instruments();
+    auto tables      = image.proximityTables();
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        const auto &instrument = instruments[i];
+
+        size_t holds = 0;
+        for (const auto &hold: image.holdBehaviours(i))
+        {
+            holds += hold.instrumentId != SFS_INVALID_INSTRUMENT_ID;
+        }
+
+        // a table's samples run up to the next table's origin
+        u32 first = tables[i].sampleIdxOrigin;
+        u32 last  = i + 1 < tables.size() ? tables[i + 1].sampleIdxOrigin : image.samples().size();
+
+        u64 pcmBytes = 0;
+        for (u32 j = first; j < last && j < image.samples().size(); j++)
+        {
+            pcmBytes += image.sampleData(image.samples()[j]).size_bytes();
+        }
+
+        std::string name(image.instrumentName(i));
+        printf("\t- %zu: %s, %u samples (%s), notes %u-%u, release %u, %zu hold behaviours\n", i, name.c_str(), last - first,
+               bytesToStr(pcmBytes).c_str(), (u32) instrument.noteRangeStart, (u32) instrument.noteRangeEnd, (u32) instrument.release, holds);
+    }
+
+    return SERR_OK;
+}
+
+synthErrno SynthFs::verifyImage(const std::filesystem::path &pImage, size_t pJobs) {
+    ImageVerifyResult result;
+    synthErrno        ret = ImageChecksum::verify(pImage, pJobs, result);
+    if (ret == SERR_SFS_INVALID_IMAGE)
+    {
+        printf("%s has no crc table, images get one from mkimg.\n", pImage.string().c_str());
+        return ret;
+    }
+
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    const auto &header  = result.header;
+    u64         checked = (u64) header.crcTableBlockStart * BLOCK_SIZE;
+
+    printf("Verified %s of %s in %.3f s, %.1f MiB/s%s:\n", bytesToStr(checked).c_str(), pImage.string().c_str(), result.seconds,
+           checked / (result.seconds + 1e-9) / (1 << 20), result.accelerated ? "" : " (no crc instructions)");
+
+    if (result.badExtents.empty())
+    {
+        printf("\t- All %u extents of %u blocks match.\n", result.extents, (u32) header.crcExtentBlocks);
+        return SERR_OK;
+    }
+
+    const std::pair<u32, const char *> sections[] = {
+        {0, "header"},
+        {header.holdBehaviorDataStart, "hold behaviours"},
+        {header.pcmDataBlockStart, "resident region"},
+        {header.pcmDataBlockStart + header.residentRegionBlockCount, "PCM data"},
+        {header.stringLutBlockStart, "string LUT"},
+        {header.stringDataBlockStart, "string data"},
+        {header.instrumentInfoDataBlockStart, "instrument info"},
+        {header.sampleInfoBlockStart, "sample info"},
+        {header.proximityTableBlockStart, "proximity tables"},
+        {header.attackRegionBlockCount != 0 ? header.attackRegionBlockStart : header.crcTableBlockStart, "attack region"},
+    };
+
+    // runs of consecutive bad extents, named by the sections they fall into. a damaged header block means its section
+    // starts can not be trusted either
+    const auto &bad       = result.badExtents;
+    bool        headerBad = bad.front() == 0;
+    for (size_t i = 0; i < bad.size();)
+    {
+        size_t j = i;
+        while (j + 1 < bad.size() && bad[j + 1] == bad[j] + 1)
+        {
+            j++;
+        }
+
+        u32 first = bad[i] * header.crcExtentBlocks;
+        u32 last  = std::min<u32>((bad[j] + 1) * header.crcExtentBlocks, header.crcTableBlockStart) - 1;
+
+        std::string names;
+        for (size_t k = 0; k < std::size(sections); k++)
+        {
+            u32 sectionStart = sections[k].first;
+            u32 sectionEnd   = k + 1 < std::size(sections) ? sections[k + 1].first : header.crcTableBlockStart;
+
+            if (sectionStart < sectionEnd && first < sectionEnd && last >= sectionStart)
+            {
+                names += (names.empty() ? "" : ", ") + std::string(sections[k].second);
+            }
+        }
+
+        if (headerBad && first != 0)
+        {
+            names = "sections unknown";
+        }
+
+        printf("\t- Blocks %u-%u do not match (%s)\n", first, last, names.c_str());
+        i = j + 1;
+    }
+
+    printf("\n%zu of %u extents do not match.\n", bad.size(), result.extents);
+
+    return SERR_SFS_CHECKSUM_MISMATCH;
+}
+
 std::string instrumentNameToStringId(std::string pName) {
     std::string out;
     for (char c: pName)
@@ -687,185 +2099,188 @@ void writeJson(const nlohmann::json &pJson, const std::filesystem::path &pFile)
     o.close();
 }
 
-// synthErrno SynthFs::extractImage() {
-//     std::filesystem::path dst            = "extracted";
-//     std::filesystem::path fontDst        = dst / "synth-font";
-//     std::filesystem::path instrumentsDst = dst / "instruments";
-//
-//     std::filesystem::create_directories(dst);
-//     std::filesystem::create_directories(fontDst);
-//     std::filesystem::create_directories(instrumentsDst);
-//
-//     std::ifstream fileStream("synth.bin", std::ios::binary | std::ios::in);
-//
-//     sfsHeader header;
-//     fileStream.read((char *) &header, sizeof(sfsHeader));
-//
-//     auto stringLutRead = [&](size_t idx) {
-//         auto buf = new char[0x400];
-//
-//         if (!fileStream.good())
-//         {
-//             return std::string("NULL");
-//         }
-//
-//         fileStream.seekg(header.stringLutBlockStart * BLOCK_SIZE + idx * sizeof(u32), std::ios::beg);
-//         fileStream.read(buf, sizeof(u32));
-//
-//         fileStream.seekg(header.stringDataBlockStart * BLOCK_SIZE + *(u32 *) buf, std::ios::beg);
-//         fileStream.read(buf, 0x400);
-//
-//         std::string ret = std::string(buf);
-//         delete[] buf;
-//
-//         return ret;
-//     };
-//
-//     auto sampleInfoRead = [&](size_t idx) {
-//         sfsInstrumentSample sample;
-//
-//         fileStream.seekg((u64) header.sampleInfoBlockStart * BLOCK_SIZE + idx * sizeof(sfsInstrumentSample), std::ios::beg);
-//         fileStream.read((char *) &sample, sizeof(sfsInstrumentSample));
-//
-//         return sample;
-//     };
-//
-//     // auto fontBuf = new u8[SFS_FONT_SIZE];
-//     // fileStream.seekg(header.fontDataBlockStart * BLOCK_SIZE, std::ios::beg);
-//     // fileStream.read((char *) fontBuf, SFS_FONT_SIZE);
-//     // delete[] fontBuf;
-//     //
-//     // writeToFile(fontDst / "font.bin", fontBuf, SFS_FONT_SIZE);
-//
-//     auto instruments = new sfsSingleInstrument[header.instrumentCount];
-//
-//     fileStream.seekg(BLOCK_SIZE * header.instrumentInfoDataBlockStart, std::ios::beg);
-//     fileStream.read((char *) instruments, header.instrumentCount * sizeof(sfsSingleInstrument));
-//
-//     for (size_t i = 0; i < header.instrumentCount; i++)
-//     {
-//         auto instrument    = instruments[i];
-//         u16  idx           = instrument.nameStrIndex;
-//         auto name          = stringLutRead(idx);
-//         auto strId         = instrumentNameToStringId(name);
-//         auto instrumentDst = instrumentsDst / strId;
-//         std::filesystem::create_directories(instrumentDst);
-//
-//         printf("Writing instrument %03llu / %03d - '%s'\r", i, header.instrumentCount, strId.c_str());
-//
-//         nlohmann::json config = {
-//             {"single", true},
-//             {"name", name},
-//             {"soundType", ""},
-//             {"fadeForced", (f32) instrument.release},
-//         };
-//
-//         std::string soundType;
-//         if (instrument.soundType & SFS_SOUND_TYPE_ATTACK)
-//         {
-//             soundType += "attack";
-//         }
-//
-//         if (instruments->soundType & SFS_SOUND_TYPE_LOOP)
-//         {
-//             soundType += " loop";
-//         }
-//
-//         config["soundType"] = soundType;
-//         config["loopInfo"]  = nullptr;
-//
-//         sfsKeyProximityTable table;
-//         fileStream.seekg(BLOCK_SIZE * header.proximityTableBlockStart + i * sizeof(sfsKeyProximityTable), std::ios::beg);
-//         fileStream.read((char *) &table, sizeof(sfsKeyProximityTable));
-//
-//         for (size_t j = 0; j < SFS_KEY_COUNT; ++j)
-//         {
-//             sfsKeyProximityTableEntryVelocity *byVelocity = table.masterEntries[j].byVelocity;
-//
-//             u8 lastVelocity = 0;
-//             for (size_t k = 0; k < SFS_MAX_VELOCITY_COUNT; ++k)
-//             {
-//                 auto entry    = byVelocity[k];
-//                 auto velocity = entry.velocity;
-//                 if (velocity < lastVelocity)
-//                 {
-//                     break;
-//                 }
-//                 lastVelocity = velocity;
-//
-//                 printf("\t%d\n", table.sampleIdxOrigin + entry.sampleIdx);
-//
-//                 auto sample = sampleInfoRead((u32) table.sampleIdxOrigin + entry.sampleIdx);
-//
-//                 auto                  keyAbs  = SFS_FIRST_KEY + j;
-//                 std::filesystem::path wavFile = instrumentDst / (std::to_string(keyAbs) + "_" + std::to_string(velocity) + ".wav");
-//
-//                 if (!std::filesystem::exists(wavFile))
-//                 {
-//                     std::ofstream wav(wavFile, std::ios::out | std::ios::binary);
-//
-//                     auto pcmSize = sample.pcmDataLengthSamples * SAMPLE_SIZE;
-//
-//                     fileStream.seekg(BLOCK_SIZE * sample.pcmDataBlockOffset, std::ios::beg);
-//
-//                     auto buf = new u8[pcmSize];
-//                     fileStream.read((str) buf, pcmSize);
-//
-//                     wavWriteFileDefault(wavFile.generic_string().c_str(), buf, pcmSize);
-//                 }
-//
-//                 if (instruments->soundType & SFS_SOUND_TYPE_LOOP)
-//                 {
-//                     config["loopInfo"]["notes"][std::to_string(keyAbs)] = {
-//                         (u32) sample.loopStart, (u16) sample.loopDuration
-//                     };
-//                 }
-//
-//                 lastVelocity = velocity;
-//             }
-//         }
-//     }
-//
-//     // hold behaviours
-//     {
-//         nlohmann::json holdJson;
-//
-//         fileStream.seekg(BLOCK_SIZE * header.holdBehaviorDataStart, std::ios::beg);
-//
-//         for (size_t i = 0; i < header.instrumentCount; i++)
-//         {
-//             sfsHoldBehaviour hold;
-//             fileStream.read((str) &hold, sizeof(sfsHoldBehaviour));
-//
-//             if (hold.instrumentId == SFS_INVALID_INSTRUMENT_ID)
-//             {
-//                 continue;
-//             }
-//
-//             auto instrument      = instruments[i];
-//             auto name            = stringLutRead(instrument.nameStrIndex);
-//             auto instrumentStrId = instrumentNameToStringId(name);
-//
-//             // casting so json does not treat packed fields as references
-//             holdJson[instrumentStrId] = {
-//                 {
-//                     {"triggerTime", (f32) hold.triggerTime},
-//                     {"maxTriggerTime", (f32) hold.maxTriggerTime},
-//                     {"transitionTime", (f32) hold.transitionTime},
-//                     {"instrument", instrumentStrId},
-//                 }
-//             };
-//
-//             writeJson(holdJson, instrumentsDst / instrumentStrId / "hold.json");
-//         }
-//     }
-//
-//     // wav data
-//     {
-//     }
-//
-//     delete[] instruments;
-//     fileStream.close();
-//
-//     return SERR_OK;
-// }
+// hold.json keys are patterns, folder names may carry regex metacharacters
+static std::string escapePattern(const std::string &pText) {
+    std::string out;
+    for (char c: pText)
+    {
+        if (strchr(".^$|()[]{}*+?\\", c) != nullptr)
+        {
+            out += '\\';
+        }
+
+        out += c;
+    }
+
+    return out;
+}
+
+synthErrno SynthFs::extractImage(const std::filesystem::path &pImage, const std::filesystem::path &pDst, size_t pJobs) {
+    SfsImage   image;
+    synthErrno ret = image.open(pImage);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    auto instrumentsDst = pDst / "instruments";
+
+    std::error_code ec;
+    std::filesystem::create_directories(instrumentsDst, ec);
+    if (ec)
+    {
+        return SERR_GENERIC_ERROR;
+    }
+
+    auto instruments = image.instruments();
+    auto tables      = image.proximityTables();
+    auto samples     = image.samples();
+
+    // mkimg numbers instruments in folder name order, the index prefix keeps ids (and so hold targets) the same when
+    // the extracted folders are built again
+    std::vector<std::string> folderNames(instruments.size());
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        folderNames[i] = std::format("{:03}-{}", i, instrumentNameToStringId(std::string(image.instrumentName(i))));
+    }
+
+    printf("Extracting %zu instruments from %s to %s\n", instruments.size(), pImage.string().c_str(), instrumentsDst.string().c_str());
+
+    // every instrument writes only into its own folder, straight from the mapping
+    std::vector<synthErrno> results(instruments.size(), SERR_OK);
+    std::vector<u64>        written(instruments.size(), 0);
+
+    ThreadPool pool(pJobs);
+    pool.parallelFor(instruments.size(), [&](size_t pIdx) {
+        const auto &instrument    = instruments[pIdx];
+        const auto &table         = tables[pIdx];
+        auto        instrumentDst = instrumentsDst / folderNames[pIdx];
+        bool        looping       = instrument.soundType & SFS_SOUND_TYPE_LOOP;
+
+        std::error_code dirEc;
+        std::filesystem::create_directories(instrumentDst, dirEc);
+        if (dirEc)
+        {
+            results[pIdx] = SERR_GENERIC_ERROR;
+            return;
+        }
+
+        // a pitch offset anywhere means the keys between samples were filled virtually
+        bool virtualFill = false;
+        for (const auto &master: table.masterEntries)
+        {
+            for (const auto &entry: master.byVelocity)
+            {
+                virtualFill |= entry.velocity != SFS_INVALID_VELOCITY && entry.semitoneOffset != 0;
+            }
+        }
+
+        nlohmann::json config = {
+            {"name", std::string(image.instrumentName(pIdx))},
+            {"looping", looping},
+            {"release", (u32) instrument.release},
+        };
+
+        if (virtualFill)
+        {
+            config["virtualFill"] = true;
+        }
+
+        u32 first = table.sampleIdxOrigin;
+        u32 last  = pIdx + 1 < tables.size() ? tables[pIdx + 1].sampleIdxOrigin : samples.size();
+
+        // mkimg encodes a whole instrument one way, encoded instruments come back decoded
+        if (first < last && first < samples.size() && samples[first].encoding != SFS_SAMPLE_ENCODING_PCM16)
+        {
+            config["encoding"] = encodingName(samples[first].encoding);
+        }
+
+        writeJson(config, instrumentDst / "instrument.json");
+
+        std::vector<s16> pcm;
+        std::vector<u8>  wav;
+        for (u32 i = first; i < last && i < samples.size(); i++)
+        {
+            const auto &sample = samples[i];
+            if (!image.decode(sample, pcm))
+            {
+                results[pIdx] = SERR_SFS_INVALID_IMAGE;
+                return;
+            }
+
+            auto filenameBase = std::to_string(sample.pitchSemitones) + "_" + std::to_string(sample.velocity);
+
+            wav.resize(sizeof(wavHeader) + pcm.size() * SAMPLE_SIZE);
+            u32 wavSize = wavWrite(wav.data(), 16, 1, SFS_SAMPLERATE, (u8 *) pcm.data(), pcm.size() * SAMPLE_SIZE);
+
+            std::ofstream out(instrumentDst / (filenameBase + ".wav"), std::ios::binary);
+            out.write((const char *) wav.data(), wavSize);
+            if (!out.good())
+            {
+                results[pIdx] = SERR_GENERIC_ERROR;
+                return;
+            }
+
+            written[pIdx] += wavSize;
+
+            if (looping)
+            {
+                nlohmann::json loop = {
+                    {"loopStart", (u32) sample.loopStart},
+                    {"loopDuration", (u32) sample.loopDuration},
+                };
+
+                writeJson(loop, instrumentDst / (filenameBase + ".json"));
+            }
+        }
+    });
+
+    u64 totalWritten = 0;
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        if (results[i] != SERR_OK)
+        {
+            printf("\t- %s failed (%d)\n", folderNames[i].c_str(), results[i]);
+            return results[i];
+        }
+
+        totalWritten += written[i];
+    }
+
+    // hold behaviours, the first slot of every row is the reserved dummy
+    nlohmann::json holdJson;
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        nlohmann::json behaviours = nlohmann::json::array();
+        for (const auto &hold: image.holdBehaviours(i))
+        {
+            if (hold.instrumentId == SFS_INVALID_INSTRUMENT_ID || hold.instrumentId >= instruments.size())
+            {
+                continue;
+            }
+
+            // casting so json does not treat packed fields as references
+            behaviours.push_back({
+                {"triggerTime", (f32) hold.triggerTime},
+                {"maxTriggerTime", (f32) hold.maxTriggerTime},
+                {"transitionTime", (f32) hold.transitionTime},
+                {"instrument", folderNames[hold.instrumentId]},
+            });
+        }
+
+        if (!behaviours.empty())
+        {
+            holdJson[escapePattern(folderNames[i])] = behaviours;
+        }
+    }
+
+    if (holdJson != nullptr)
+    {
+        writeJson(holdJson, instrumentsDst / "hold.json");
+        printf("\t- %zu hold behaviour rows\n", holdJson.size());
+    }
+
+    printf("\t- %zu samples, %s of wavs on %zu threads\n", samples.size(), bytesToStr(totalWritten).c_str(), pool.threadCount());
+
+    return SERR_OK;
+}
@@ -11,6 +11,12 @@
 #include <filesystem>
 #include <json.hpp>
 
+#include "adpcm.h"
+#include "image_writer.h"
+#include "lossless.h"
+#include "mapped_file.h"
+#include "pcm_layout.h"
+
 extern "C" {
 #include "sfs/sfs.h"
 #include "types.h"
@@ -24,16 +30,99 @@ extern "C" {
 #define obpos(s) (opos(s) / BLOCK_SIZE)
 #define ibpos(s) (ipos(s) / BLOCK_SIZE)
 
+// where a sample's pcm lives in its source wav, recorded by the layout pass and read only when it is written
+struct SamplePcmSource {
+    std::filesystem::path file;
+    u64                   dataOffset;
+    u32                   dataSize;
+};
+
+struct ImageBuildOptions {
+    size_t jobs   = 1;     // ingestion threads, 0 uses every hardware thread
+    bool   full   = false; // ignore the manifest and rebuild everything
+    bool   direct = false; // write the image around the page cache
+
+    pcmLayoutPolicy       layout          = PCM_LAYOUT_INSTRUMENT;
+    std::filesystem::path trace;                // midi file for PCM_LAYOUT_TRACE, also weighs the resident samples
+    int                   traceInstrument = -1; // see SeekEstimateOptions::instrument
+    u32                   allocationUnit  = 0;  // bytes, large samples start on a multiple of it, 0 disables
+    std::filesystem::path metrics;              // json report of per phase timings and byte counts, empty skips it
+    u16                   crcExtentBlocks = 1;  // blocks per crc table entry, 0 leaves the table out
+    u32                   attackBlocks    = 0;  // blocks of every sample copied to the attack region, see sfsHeader
+    u64                   residentBudget  = 0;  // bytes of device ram for whole samples loaded at boot, 0 streams everything
+    sfsProximityEncoding  proximity       = SFS_PROXIMITY_FULL; // compact only once the firmware reads the encoding
+};
+
+struct IngestedInstrument {
+    sfsSingleInstrument instrument; // without name index and note range, those are assigned when merging
+    std::string         name;
+    bool                virtualFill;
+    sfsSampleEncoding   encoding;     // of every sample, "encoding" in instrument.json
+    s32                 attackBlocks; // "attackBlocks" in instrument.json, -1 takes ImageBuildOptions::attackBlocks
+    u64                 metaHash;
+    u64                 bytesRead;
+    synthErrno          ret;
+};
+
+#define SFS_ANALYSIS_CLIP_LEVEL 32767
+#define SFS_ANALYSIS_DC_LIMIT 328 // 1% of full scale
+#define FS_ENCODE_CHUNK_BLOCKS 64        // adpcm samples are read and encoded this many blocks at a time
+#define FS_ENCODE_BATCH_BYTES (64 << 20) // lossless samples are encoded in batches of about this much pcm
+#define FS_ENCODE_BATCH_FILES 256        // and at most this many wavs mapped at once
+
+// what is measured of a sample's pcm on its way into the image. the mean absolute amplitudes go into the sample
+// info, the rest is reported in the build metrics. valid is false for samples an incremental build did not stream
+struct SampleAnalysis {
+    u16  startMeanAbs, endMeanAbs; // over the first and last 10000 samples
+    u16  startRms, endRms;
+    u16  peak; // largest |sample|, 32768 is a full scale negative one
+    s16  dcOffset;
+    bool valid;
+
+    AdpcmError codecError; // of the decoded sample against the wav, zero for pcm16
+};
+
+struct IngestedSample {
+    size_t              instrumentIdx;
+    u8                  semitone;
+    u8                  velocity;
+    sfsInstrumentSample sample; // without block offset, assigned when merging
+    SamplePcmSource     source;
+    u64                 pcmHash;   // of the pcm itself, equal hashes are compared byte for byte before sharing
+    bool                pcmHashed; // only pcm whose size another sample shares is hashed, the rest cannot be shared
+    u64                 metaHash;
+    u64                 pcmStamp;
+    u64                 bytesRead; // wav chunks around the pcm and loop json
+    synthErrno          ret;
+};
+
 class SynthFs {
+private:
+    static synthErrno ingestInstrument(const std::filesystem::path &pInstrumentPath, IngestedInstrument &pOut);
+    static synthErrno ingestSample(const std::filesystem::path &pInstrumentPath, const IngestedInstrument &pInstrument,
+                                   IngestedSample &pOut);
+    static bool samePcm(const MappedFile &pA, const SamplePcmSource &pSourceA, const MappedFile &pB, const SamplePcmSource &pSourceB);
+
+    // pcm16 and adpcm samples, lossless ones are encoded and measured ahead of the layout
+    static synthErrno streamSamplePcm(ImageWriter &pOut, const SamplePcmSource &pSource, sfsSampleEncoding pEncoding, SampleAnalysis &pAnalysis);
+
 public:
     static synthErrno     flashImage();
-    static synthErrno     extractImage();
-    static synthErrno     writeImage(std::filesystem::path pInstrumentsFolder);
+    static synthErrno     extractImage(const std::filesystem::path &pImage, const std::filesystem::path &pDst, size_t pJobs);
+    static synthErrno     inspectImage(const std::filesystem::path &pImage);
+    static synthErrno     verifyImage(const std::filesystem::path &pImage, size_t pJobs);
+    static synthErrno     writeImage(std::filesystem::path pInstrumentsFolder, const ImageBuildOptions &pOptions);
     static void           copyStream(std::ofstream &pOfstream, std::ifstream &pIfstream);
     static size_t         writeFileToOfstream(std::ofstream &pOfstream, const char *pFile);
     static size_t         writeToFile(const std::filesystem::path &pFile, void *pData, size_t pSize);
     static void           padStream(std::ostream &pOstream, size_t pTo);
     static nlohmann::json loadJson(const char *pFile);
+
+    static bool        parseEncoding(const std::string &pName, sfsSampleEncoding &pEncoding);
+    static const char *encodingName(sfsSampleEncoding pEncoding);
+
+    // blocks a sample of pDataSize wav bytes takes in the image, an upper bound for lossless samples
+    static u32 encodedBlocks(sfsSampleEncoding pEncoding, u32 pDataSize);
 };
 
 #endif //FS_H
@@ -0,0 +1,39 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef HASH_H
+#define HASH_H
+
+#include <string_view>
+
+#include "types.h"
+
+#define HASH_FNV1A_SEED 0xCBF29CE484222325ull
+#define HASH_FNV1A_PRIME 0x100000001B3ull
+
+// fnv-1a 64, chain calls by passing the previous result as pSeed
+inline u64 hashFnv1a(const void *pData, size_t pSize, u64 pSeed = HASH_FNV1A_SEED) {
+    auto bytes = (const u8 *) pData;
+    u64  hash  = pSeed;
+
+    for (size_t i = 0; i < pSize; ++i)
+    {
+        hash ^= bytes[i];
+        hash *= HASH_FNV1A_PRIME;
+    }
+
+    return hash;
+}
+
+inline u64 hashFnv1a(std::string_view pStr, u64 pSeed = HASH_FNV1A_SEED) {
+    return hashFnv1a(pStr.data(), pStr.size(), pSeed);
+}
+
+template<typename T>
+inline u64 hashFnv1aValue(const T &pValue, u64 pSeed = HASH_FNV1A_SEED) {
+    return hashFnv1a(&pValue, sizeof(T), pSeed);
+}
+
+#endif //HASH_H
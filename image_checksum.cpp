@@ -0,0 +1,118 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+
+#include "image_checksum.h"
+
+#include "crc32c.h"
+#include "thread_pool.h"
+
+synthErrno ImageChecksum::compute(const std::filesystem::path &pFile, u32 pBlockCount, u32 pExtentBlocks, size_t pJobs,
+                                  std::vector<u32> &pCrcs) {
+    if (pExtentBlocks == 0)
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    u32 extents      = (pBlockCount + pExtentBlocks - 1) / pExtentBlocks;
+    u32 chunkExtents = std::max<u32>(1, IMAGE_CHECKSUM_CHUNK_BLOCKS / pExtentBlocks);
+    u32 chunks       = (extents + chunkExtents - 1) / chunkExtents;
+
+    pCrcs.assign(extents, 0);
+
+    // every chunk opens its own stream, so workers never share a file position
+    std::vector<synthErrno> results(chunks, SERR_OK);
+
+    ThreadPool pool(pJobs);
+    pool.parallelFor(chunks, [&](size_t pIdx) {
+        u32 firstExtent = pIdx * chunkExtents;
+        u32 lastExtent  = std::min(extents, firstExtent + chunkExtents);
+        u32 firstBlock  = firstExtent * pExtentBlocks;
+        u32 blocks      = std::min(pBlockCount, lastExtent * pExtentBlocks) - firstBlock;
+
+        std::vector<u8> buf((size_t) blocks * BLOCK_SIZE);
+        std::ifstream   in(pFile, std::ios::binary);
+
+        in.seekg((u64) firstBlock * BLOCK_SIZE, std::ios::beg);
+        in.read((char *) buf.data(), buf.size());
+        if (!in.good())
+        {
+            results[pIdx] = SERR_SD_READ_ERROR;
+            return;
+        }
+
+        for (u32 e = firstExtent; e < lastExtent; e++)
+        {
+            u32 offset = (e - firstExtent) * pExtentBlocks;
+            u32 count  = std::min(pExtentBlocks, blocks - offset);
+
+            pCrcs[e] = crc32c(buf.data() + (size_t) offset * BLOCK_SIZE, (size_t) count * BLOCK_SIZE);
+        }
+    });
+
+    for (auto result: results)
+    {
+        if (result != SERR_OK)
+        {
+            return result;
+        }
+    }
+
+    return SERR_OK;
+}
+
+synthErrno ImageChecksum::verify(const std::filesystem::path &pFile, size_t pJobs, ImageVerifyResult &pResult) {
+    auto start = std::chrono::steady_clock::now();
+
+    pResult = {};
+
+    std::ifstream in(pFile, std::ios::binary);
+    in.read((char *) &pResult.header, sizeof(sfsHeader));
+    if (!in.good())
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    const auto &header = pResult.header;
+    if (header.magic != SFS_MAGIC || header.crcTableBlockStart == 0 || header.crcExtentBlocks == 0)
+    {
+        return SERR_SFS_INVALID_IMAGE;
+    }
+
+    pResult.extents = sfsCrcExtentCount(header);
+
+    std::vector<u32> table(pResult.extents);
+    in.seekg((u64) header.crcTableBlockStart * BLOCK_SIZE, std::ios::beg);
+    in.read((char *) table.data(), table.size() * sizeof(u32));
+    if (!in.good())
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    in.close();
+
+    std::vector<u32> crcs;
+    synthErrno       ret = compute(pFile, header.crcTableBlockStart, header.crcExtentBlocks, pJobs, crcs);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    for (u32 i = 0; i < pResult.extents; i++)
+    {
+        if (crcs[i] != table[i])
+        {
+            pResult.badExtents.push_back(i);
+        }
+    }
+
+    pResult.accelerated = crc32cAccelerated();
+    pResult.seconds     = std::chrono::duration<f64>(std::chrono::steady_clock::now() - start).count();
+
+    return SERR_OK;
+}
@@ -0,0 +1,42 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef IMAGE_CHECKSUM_H
+#define IMAGE_CHECKSUM_H
+
+#include <filesystem>
+#include <vector>
+
+#include "types.h"
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+#define IMAGE_CHECKSUM_CHUNK_BLOCKS 2048 // blocks one worker reads at a time, rounded to whole extents
+
+struct ImageVerifyResult {
+    sfsHeader        header;
+    u32              extents;
+    std::vector<u32> badExtents; // ascending
+    f64              seconds;
+    bool             accelerated; // crc instructions were used
+};
+
+// per extent crc32c of an image, used by mkimg to fill the crc table and by verify to check an image or a card
+// against it. everything goes through plain positioned reads so a raw device path works as well as a file, the
+// extents are split into chunks that the pool reads and checksums independently.
+class ImageChecksum {
+public:
+    // crc of every pExtentBlocks blocks of [0, pBlockCount), the last extent may be shorter
+    static synthErrno compute(const std::filesystem::path &pFile, u32 pBlockCount, u32 pExtentBlocks, size_t pJobs,
+                              std::vector<u32> &pCrcs);
+
+    // reads the header and crc table of pFile and recomputes every extent. SERR_SFS_INVALID_IMAGE when the image has
+    // no table, a mismatch is not an error but fills badExtents
+    static synthErrno verify(const std::filesystem::path &pFile, size_t pJobs, ImageVerifyResult &pResult);
+};
+
+#endif //IMAGE_CHECKSUM_H
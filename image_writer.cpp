@@ -0,0 +1,277 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#include "image_writer.h"
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+ImageWriter::ImageWriter() {
+    buf       = nullptr;
+    bufLen    = 0;
+    bufOffset = 0;
+    pos       = 0;
+    size      = 0;
+    direct    = false;
+    failed    = false;
+
+    #ifdef _WIN32
+    handle = nullptr;
+    #else
+    fd = -1;
+    #endif
+}
+
+ImageWriter::~ImageWriter() {
+    close();
+}
+
+bool ImageWriter::open(const std::filesystem::path &pFile, const ImageWriterOptions &pOptions) {
+    close();
+
+    bufLen    = 0;
+    bufOffset = 0;
+    pos       = 0;
+    size      = pOptions.size;
+    direct    = pOptions.direct;
+    failed    = false;
+
+    #ifdef _WIN32
+    DWORD disposition = pOptions.truncate ? CREATE_ALWAYS : OPEN_EXISTING;
+    DWORD flags       = FILE_ATTRIBUTE_NORMAL | FILE_FLAG_SEQUENTIAL_SCAN;
+
+    HANDLE file = CreateFileW(pFile.c_str(), GENERIC_WRITE, 0, nullptr, disposition,
+                              direct ? flags | FILE_FLAG_NO_BUFFERING | FILE_FLAG_WRITE_THROUGH : flags, nullptr);
+    if (file == INVALID_HANDLE_VALUE && direct)
+    {
+        direct = false;
+        file   = CreateFileW(pFile.c_str(), GENERIC_WRITE, 0, nullptr, disposition, flags, nullptr);
+    }
+
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    handle = file;
+
+    if (size != 0)
+    {
+        LARGE_INTEGER end;
+        end.QuadPart = size;
+        SetFilePointerEx(file, end, nullptr, FILE_BEGIN);
+        SetEndOfFile(file);
+    }
+    #else
+    int flags = O_WRONLY | O_CREAT | (pOptions.truncate ? O_TRUNC : 0);
+
+    #ifdef O_DIRECT
+    fd = direct ? ::open(pFile.c_str(), flags | O_DIRECT, 0644) : -1;
+    #endif
+
+    if (fd < 0)
+    {
+        direct = false;
+        fd     = ::open(pFile.c_str(), flags, 0644);
+    }
+
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    // reserving the extents up front keeps a large image from fragmenting, filesystems without it just skip this
+    #ifdef __linux__
+    if (size != 0)
+    {
+        fallocate(fd, 0, 0, size);
+    }
+    #endif
+    #endif
+
+    buf = (u8 *) ::operator new(IMAGE_WRITER_BUFFER_SIZE, std::align_val_t(IMAGE_WRITER_ALIGNMENT));
+
+    return true;
+}
+
+bool ImageWriter::close() {
+    if (!buf)
+    {
+        return !failed;
+    }
+
+    flush();
+
+    #ifdef _WIN32
+    if (size != 0)
+    {
+        LARGE_INTEGER end;
+        end.QuadPart = size;
+        failed |= !SetFilePointerEx(handle, end, nullptr, FILE_BEGIN) || !SetEndOfFile(handle);
+    }
+
+    CloseHandle(handle);
+    handle = nullptr;
+    #else
+    // trailing padding was never written, and direct mode may have rounded the last flush past the end
+    if (size != 0)
+    {
+        failed |= ftruncate(fd, size) != 0;
+    }
+
+    failed |= ::close(fd) != 0;
+    fd = -1;
+    #endif
+
+    ::operator delete(buf, std::align_val_t(IMAGE_WRITER_ALIGNMENT));
+    buf = nullptr;
+
+    return !failed;
+}
+
+bool ImageWriter::writeAt(const u8 *pData, size_t pLen, u64 pOffset) {
+    while (pLen > 0)
+    {
+        #ifdef _WIN32
+        OVERLAPPED overlapped = {};
+        overlapped.Offset     = (DWORD) pOffset;
+        overlapped.OffsetHigh = (DWORD) (pOffset >> 32);
+
+        DWORD done = 0;
+        if (!WriteFile(handle, pData, (DWORD) pLen, &done, &overlapped) || done == 0)
+        {
+            return false;
+        }
+        #else
+        ssize_t done = pwrite(fd, pData, pLen, pOffset);
+        if (done < 0 && errno == EINTR)
+        {
+            continue;
+        }
+
+        #ifdef O_DIRECT
+        // some filesystems accept O_DIRECT on open and refuse it on the first write
+        if (done < 0 && errno == EINVAL && direct)
+        {
+            direct = false;
+            fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) & ~O_DIRECT);
+            continue;
+        }
+        #endif
+
+        if (done <= 0)
+        {
+            return false;
+        }
+        #endif
+
+        pData += done;
+        pLen -= done;
+        pOffset += done;
+    }
+
+    return true;
+}
+
+bool ImageWriter::flush() {
+    if (bufLen == 0 || failed)
+    {
+        bufLen = 0;
+        return !failed;
+    }
+
+    size_t len = bufLen;
+    if (direct)
+    {
+        len = roundUpTo(len, IMAGE_WRITER_SECTOR);
+        memset(buf + bufLen, 0, len - bufLen);
+    }
+
+    failed |= !writeAt(buf, len, bufOffset);
+    bufLen = 0;
+
+    return !failed;
+}
+
+void ImageWriter::seek(u64 pOffset) {
+    pos = pOffset;
+}
+
+void ImageWriter::pad(size_t pTo) {
+    seek(roundUpTo(pos, pTo));
+}
+
+u8 *ImageWriter::reserve(size_t pMin, size_t &pLen) {
+    if (bufLen != 0 && pos != bufOffset + bufLen)
+    {
+        flush();
+    }
+    else if (IMAGE_WRITER_BUFFER_SIZE - bufLen < pMin)
+    {
+        // a partial sector stays behind so unbuffered writes keep starting on one
+        u8     tail[IMAGE_WRITER_SECTOR];
+        size_t keep   = direct ? bufLen % IMAGE_WRITER_SECTOR : 0;
+        u64    offset = bufOffset + bufLen - keep;
+
+        bufLen -= keep;
+        memcpy(tail, buf + bufLen, keep);
+        flush();
+
+        memcpy(buf, tail, keep);
+        bufLen    = keep;
+        bufOffset = offset;
+    }
+
+    if (bufLen == 0)
+    {
+        // unbuffered writes can only start on a sector
+        if (direct && pos % IMAGE_WRITER_SECTOR != 0)
+        {
+            failed = true;
+        }
+
+        bufOffset = pos;
+    }
+
+    pLen = IMAGE_WRITER_BUFFER_SIZE - bufLen;
+    return buf + bufLen;
+}
+
+void ImageWriter::commit(size_t pLen) {
+    bufLen += pLen;
+    pos += pLen;
+
+    if (bufLen == IMAGE_WRITER_BUFFER_SIZE)
+    {
+        flush();
+    }
+}
+
+void ImageWriter::write(const void *pData, size_t pLen) {
+    auto src = (const u8 *) pData;
+
+    while (pLen > 0)
+    {
+        size_t space;
+        u8    *dst = reserve(1, space);
+        size_t len = std::min(space, pLen);
+
+        memcpy(dst, src, len);
+        commit(len);
+
+        src += len;
+        pLen -= len;
+    }
+}
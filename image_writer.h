@@ -0,0 +1,78 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef IMAGE_WRITER_H
+#define IMAGE_WRITER_H
+
+#include <filesystem>
+
+#include "types.h"
+
+#define IMAGE_WRITER_BUFFER_SIZE (4 << 20)
+#define IMAGE_WRITER_ALIGNMENT 4096 // staging buffer address, enough for unbuffered io on any sector size
+#define IMAGE_WRITER_SECTOR 0x200   // unbuffered offsets and lengths are multiples of this
+
+struct ImageWriterOptions {
+    bool direct   = false; // bypass the page cache (O_DIRECT, FILE_FLAG_NO_BUFFERING), falls back when refused
+    bool truncate = true;  // false rewrites an existing image in place
+    u64  size     = 0;     // final image size, preallocated on open and set on close
+};
+
+// positioned writes (pwrite / WriteFile at an offset) through one large aligned staging buffer. consecutive writes
+// are coalesced, seeking elsewhere flushes and leaves whatever lies between untouched, so padding is a hole rather
+// than written zeros. in direct mode every flush is rounded up to a whole sector with zeros, which the image format
+// allows since every section is padded to a block.
+class ImageWriter {
+private:
+    u8    *buf;
+    size_t bufLen;
+    u64    bufOffset; // file offset of buf[0]
+    u64    pos;
+    u64    size;
+    bool   direct;
+    bool   failed;
+
+    #ifdef _WIN32
+    void *handle;
+    #else
+    int fd;
+    #endif
+
+    bool flush();
+    bool writeAt(const u8 *pData, size_t pLen, u64 pOffset);
+
+public:
+    ImageWriter();
+    ~ImageWriter();
+
+    ImageWriter(const ImageWriter &)            = delete;
+    ImageWriter &operator=(const ImageWriter &) = delete;
+
+    bool open(const std::filesystem::path &pFile, const ImageWriterOptions &pOptions);
+    bool close();
+
+    void write(const void *pData, size_t pLen);
+    void seek(u64 pOffset);
+    void pad(size_t pTo);
+
+    // pointer to at least pMin bytes of staging buffer at the current position, pLen gets the space available.
+    // lets a producer fill the buffer in place, commit says how much of it was used
+    u8  *reserve(size_t pMin, size_t &pLen);
+    void commit(size_t pLen);
+
+    u64 tell() const {
+        return pos;
+    }
+
+    bool good() const {
+        return !failed;
+    }
+
+    bool isDirect() const {
+        return direct;
+    }
+};
+
+#endif //IMAGE_WRITER_H
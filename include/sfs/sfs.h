@@ -35,10 +35,47 @@ typedef pstruct {
 
     u16 singleInstrumentCount;
     u16 multiInstrumentCount;
+
+    u16 holdBehaviourStride; // hold behaviours per single instrument, 0 in images from before it was recorded (1)
+
+    u32 crcTableBlockStart; // u32 crc32c per extent of every block before it, 0 if the image has no table
+    u16 crcExtentBlocks;    // blocks covered by one crc, the last extent may be shorter
+
+    u32 attackRegionBlockStart; // copies of the first blocks of samples, read into ram in one go at boot, 0 if none
+    u32 attackRegionBlockCount;
+
+    u32 residentRegionBlockStart; // whole samples read into ram at boot, at the start of the pcm data. 0 if none
+    u32 residentRegionBlockCount;
+
+    u8 proximityTableEncoding; // sfsProximityEncoding of the proximity table section
 } sfsHeader;
 
 #define SFS_MAGIC magic('S', 'Y', 'L', 'Z')
 
+#define sfsCrcExtentCount(h) (((h).crcTableBlockStart + (h).crcExtentBlocks - 1) / (h).crcExtentBlocks)
+
+typedef enum : u8 {
+    SFS_SAMPLE_ENCODING_PCM16, // raw s16, SAMPLES_PER_BLOCK per block
+    SFS_SAMPLE_ENCODING_ADPCM,    // ima adpcm, SFS_ADPCM_SAMPLES_PER_BLOCK per block
+    SFS_SAMPLE_ENCODING_LOSSLESS, // lpc frames with rice coded residuals, storedBlocks in total
+} sfsSampleEncoding;
+
+// an adpcm block decodes on its own: s16 first sample, u8 step index, u8 reserved, then 4 bit codes for the samples
+// after it, low nibble first. the last block of a sample is padded with zero codes.
+#define SFS_ADPCM_HEADER_SIZE 4
+#define SFS_ADPCM_SAMPLES_PER_BLOCK (1 + (BLOCK_SIZE - SFS_ADPCM_HEADER_SIZE) * 2)
+
+// a lossless sample starts with its seek index, a u32 per frame with the block the frame starts at counted from
+// pcmDataBlockOffset, padded to a block. every frame holds SFS_LOSSLESS_FRAME_SAMPLES samples (the last one the rest)
+// and starts on a block of its own. a frame taking as many blocks as its raw pcm is raw pcm, otherwise it is
+// u8 order, u8 shift, s16 coefficients[order], s16 warmup[order] and then, for every SFS_LOSSLESS_PARTITION_SAMPLES
+// samples of the frame, a 5 bit rice parameter followed by the zigzagged residuals of the samples after the warmup,
+// msb first. sample n predicts as (sum coefficients[j] * sample[n - 1 - j]) >> shift.
+#define SFS_LOSSLESS_FRAME_SAMPLES 4096
+#define SFS_LOSSLESS_PARTITION_SAMPLES 256
+#define SFS_LOSSLESS_ORDER 8
+#define SFS_LOSSLESS_RICE_BITS 5
+
 typedef pstruct {
     u32 pcmDataLengthSamples;
     u32 pcmDataBlockOffset;
@@ -49,13 +86,33 @@ typedef pstruct {
     u8 pitchSemitones;
 
     u16 startAverageAmplitude, endAverageAmplitude;
-    u8  padding[10];
+
+    sfsSampleEncoding encoding;
+    u32               storedBlocks; // index and frames of a lossless sample, 0 for the fixed rate encodings
+
+    // the first attackBlocks stored blocks are also in the attack region from attackBlockOffset on, so a voice can
+    // start from ram and stream the rest from pcmDataBlockOffset + attackBlocks. both 0 when there is no copy
+    u32 attackBlockOffset;
+    u8  attackBlocks;
 } sfsInstrumentSample;
 
+// fixed rate encodings only, a lossless block holds however many samples its frame compressed to
+#define sfsSamplesPerBlock(s) ((s).encoding == SFS_SAMPLE_ENCODING_ADPCM ? SFS_ADPCM_SAMPLES_PER_BLOCK : SAMPLES_PER_BLOCK)
+#define sfsSampleBlockCount(s) \
+    ((s).encoding == SFS_SAMPLE_ENCODING_LOSSLESS ? (s).storedBlocks : \
+     ((s).pcmDataLengthSamples + sfsSamplesPerBlock(s) - 1) / sfsSamplesPerBlock(s))
+
 assertSizeAlignedTo(sfsInstrumentSample, 0x200);
 #define SAMPLE_INFOS_PER_BLOCK (BLOCK_SIZE / sizeof(sfsInstrumentSample))
 
+// a resident sample's pcm lies in the resident region, the device plays it from its copy of the region at
+// (pcmDataBlockOffset - residentRegionBlockStart) * BLOCK_SIZE and never reads it from the card
+#define sfsSampleIsResident(h, s) \
+    ((s).pcmDataBlockOffset >= (h).residentRegionBlockStart && \
+     (s).pcmDataBlockOffset < (h).residentRegionBlockStart + (h).residentRegionBlockCount)
+
 #define SFS_INVALID_SAMPLE_IDX 0xFFFF_FFFF
+#define SFS_MAX_ATTACK_BLOCKS 0xFF
 
 typedef enum : u8 {
     SFS_SOUND_TYPE_ATTACK = 1 << 0,
@@ -93,7 +150,7 @@ assertSizeAlignedTo(sfsSingleInstrument, 0x200);
 typedef pstruct {
     u8  velocity;
     u16 sampleIdx;
-    u8  padding;
+    s8  semitoneOffset; // key - sample pitch, played back at 2^(semitoneOffset / 12) of the stored rate
 } sfsKeyProximityTableEntryVelocity;
 
 typedef pstruct {
@@ -112,6 +169,48 @@ typedef pstruct {
 static_assert(sizeof(sfsKeyProximityTable) % BLOCK_SIZE == 0);
 #define SFS_PROXIMITY_TABLE_BLOCK_SIZE (sizeof(sfsKeyProximityTable) / BLOCK_SIZE)
 
+typedef enum : u8 {
+    SFS_PROXIMITY_FULL,    // a sfsKeyProximityTable per single instrument
+    SFS_PROXIMITY_COMPACT, // u32 byte offsets of the tables (one past the last one too), then sfsCompactProximityTables
+} sfsProximityEncoding;
+
+typedef enum : u8 {
+    SFS_PROXIMITY_TRANSPOSES = 1 << 0, // a layer's semitoneOffset grows by one per key, stored as the offset at key 0
+} sfsProximityFlags;
+
+// a sfsKeyProximityTable with every distinct velocity map stored once. runs of keys sharing a map point at it from
+// keyMaps, so finding a key's layers is two array reads. mapCount sfsCompactProximityMaps follow the table, then the
+// layers of all maps, a sfsKeyProximityTableEntryVelocity each
+typedef pstruct {
+    u32               sampleIdxOrigin;
+    u8                mapCount;
+    sfsProximityFlags flags;
+    u8                keyMaps[SFS_KEY_COUNT]; // counted from SFS_FIRST_KEY
+    u8                padding;
+} sfsCompactProximityTable;
+
+typedef pstruct {
+    u16 layerStart;
+    u8  layerCount;
+    u8  padding;
+} sfsCompactProximityMap;
+
+#define sfsCompactProximityMaps(t) ((const sfsCompactProximityMap *) ((const u8 *) (t) + sizeof(sfsCompactProximityTable)))
+#define sfsCompactProximityLayers(t) ((const sfsKeyProximityTableEntryVelocity *) (sfsCompactProximityMaps(t) + (t)->mapCount))
+#define sfsCompactProximityKeyMap(t, k) (sfsCompactProximityMaps(t)[(t)->keyMaps[k]])
+
+// layer pLayer (< the key's map layerCount) of key pKey, counted from SFS_FIRST_KEY, in constant time. transposed
+// tables store offsets relative to key 0, the key is added back here
+static inline sfsKeyProximityTableEntryVelocity sfsCompactProximityLookup(const sfsCompactProximityTable *pTable, u32 pKey, u32 pLayer) {
+    sfsKeyProximityTableEntryVelocity entry = sfsCompactProximityLayers(pTable)[sfsCompactProximityKeyMap(pTable, pKey).layerStart + pLayer];
+    if (pTable->flags & SFS_PROXIMITY_TRANSPOSES)
+    {
+        entry.semitoneOffset = (s8) (entry.semitoneOffset + pKey);
+    }
+
+    return entry;
+}
+
 typedef pstruct {
     u16 subInstrumentIds[SFS_MAX_SUBINSTRUMENTS];
     u16 nameStrIndex;
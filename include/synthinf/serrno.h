@@ -22,6 +22,11 @@ typedef enum
     SERR_SFS_INVALID_SOUNDTYPE,
     SERR_SFS_VELOCITY_COUNT_EXCEEDED,
     SERR_SFS_INVALID_VELOCITY,
+    SERR_SFS_INVALID_WAV,
+    SERR_SFS_INVALID_MIDI,
+    SERR_SFS_INVALID_IMAGE,
+    SERR_SFS_CHECKSUM_MISMATCH,
+    SERR_SFS_INVALID_ENCODING,
 
     SERR_CMD_INVALID_ARGUMENT = SERR_PAGE_LEN * 2,
 
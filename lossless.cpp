@@ -0,0 +1,529 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "lossless.h"
+
+#include <array>
+#include <cmath>
+#include <cstring>
+
+#define LOSSLESS_COEFFICIENT_BITS 15 // sum of |quantized coefficients| stays below 2^15 (and rounding), so a prediction fits s32
+#define LOSSLESS_MAX_SHIFT 15
+#define LOSSLESS_MAX_RESIDUAL (1 << 24) // larger residuals mean the predictor is useless, the frame is stored raw
+#define LOSSLESS_MAX_RICE ((1 << SFS_LOSSLESS_RICE_BITS) - 1)
+
+static u32 blocksFor(size_t pBytes) {
+    return (pBytes + BLOCK_SIZE - 1) / BLOCK_SIZE;
+}
+
+u32 losslessFrameCount(size_t pCount) {
+    return (pCount + SFS_LOSSLESS_FRAME_SAMPLES - 1) / SFS_LOSSLESS_FRAME_SAMPLES;
+}
+
+u32 losslessIndexBlocks(size_t pCount) {
+    return blocksFor((size_t) losslessFrameCount(pCount) * sizeof(u32));
+}
+
+// msb first, whole bytes are appended as soon as they are complete
+struct LosslessBitWriter {
+    std::vector<u8> &out;
+    u64              acc   = 0;
+    u32              count = 0;
+
+    // pBits <= 32
+    void put(u32 pValue, u32 pBits) {
+        acc = pBits == 0 ? acc : (acc << pBits) | pValue;
+        count += pBits;
+
+        while (count >= 8)
+        {
+            count -= 8;
+            out.push_back((u8) (acc >> count));
+        }
+    }
+
+    void unary(u32 pZeros) {
+        for (; pZeros >= 32; pZeros -= 32)
+        {
+            put(0, 32);
+        }
+
+        put(1, pZeros + 1);
+    }
+
+    void flush() {
+        if (count != 0)
+        {
+            out.push_back((u8) (acc << (8 - count)));
+            count = 0;
+        }
+    }
+};
+
+// bits holds count unread bits from the top down, everything below them is zero
+struct LosslessBitReader {
+    const u8 *pos;
+    const u8 *end;
+    u64       bits    = 0;
+    u32       count   = 0;
+    bool      overrun = false;
+
+    void refill() {
+        if (count > 56)
+        {
+            return;
+        }
+
+        if (end - pos >= 8)
+        {
+            u64 word;
+            memcpy(&word, pos, sizeof(u64));
+            word = __builtin_bswap64(word);
+
+            u32 take  = (63 - count) >> 3;
+            u32 total = count + take * 8;
+
+            bits |= (word >> count) & ~(~0ull >> total);
+            count = total;
+            pos += take;
+            return;
+        }
+
+        while (count <= 56 && pos < end)
+        {
+            bits |= (u64) *pos++ << (56 - count);
+            count += 8;
+        }
+    }
+
+    void consume(u32 pBits) {
+        bits = pBits < 64 ? bits << pBits : 0;
+        count -= pBits;
+    }
+
+    // pBits <= 32
+    u32 read(u32 pBits) {
+        if (count < pBits)
+        {
+            refill();
+            if (count < pBits)
+            {
+                overrun = true;
+                return 0;
+            }
+        }
+
+        u32 value = pBits == 0 ? 0 : (u32) (bits >> (64 - pBits));
+        consume(pBits);
+        return value;
+    }
+
+    u32 unary() {
+        u32 zeros = 0;
+        while (bits == 0)
+        {
+            zeros += count;
+            count = 0;
+
+            if (pos >= end)
+            {
+                overrun = true;
+                return zeros;
+            }
+
+            refill();
+        }
+
+        u32 lead = __builtin_clzll(bits);
+        consume(lead + 1);
+        return zeros + lead;
+    }
+};
+
+// windowed autocorrelation and levinson-durbin, then quantized with error feedback so the rounding does not add up
+static void losslessCoefficients(const s16 *pSrc, size_t pCount, u32 pOrder, s16 *pCoeffs, u8 &pShift) {
+    memset(pCoeffs, 0, pOrder * sizeof(s16));
+    pShift = 0;
+
+    if (pCount <= pOrder)
+    {
+        return;
+    }
+
+    std::array<f64, SFS_LOSSLESS_FRAME_SAMPLES> windowed;
+    for (size_t i = 0; i < pCount; i++)
+    {
+        f64 x = 2.0 * i / (pCount - 1) - 1.0;
+        windowed[i] = pSrc[i] * (1.0 - x * x);
+    }
+
+    std::array<f64, SFS_LOSSLESS_ORDER + 1> r = {};
+    for (u32 lag = 0; lag <= pOrder; lag++)
+    {
+        for (size_t i = lag; i < pCount; i++)
+        {
+            r[lag] += windowed[i] * windowed[i - lag];
+        }
+    }
+
+    if (r[0] == 0)
+    {
+        return;
+    }
+
+    r[0] *= 1.0 + 1e-9;
+
+    std::array<f64, SFS_LOSSLESS_ORDER> a = {}, previous;
+    f64                                 err = r[0];
+    for (u32 i = 0; i < pOrder; i++)
+    {
+        f64 acc = r[i + 1];
+        for (u32 j = 0; j < i; j++)
+        {
+            acc -= a[j] * r[i - j];
+        }
+
+        f64 k    = acc / err;
+        previous = a;
+        for (u32 j = 0; j < i; j++)
+        {
+            a[j] = previous[j] - k * previous[i - 1 - j];
+        }
+
+        a[i] = k;
+        err *= 1.0 - k * k;
+        if (err <= 0)
+        {
+            break;
+        }
+    }
+
+    f64 magnitude = 0;
+    for (u32 i = 0; i < pOrder; i++)
+    {
+        magnitude += std::abs(a[i]);
+    }
+
+    if (magnitude < 1e-6)
+    {
+        return;
+    }
+
+    int exponent = (int) std::floor(std::log2(magnitude)) + 1;
+    int shift    = LOSSLESS_COEFFICIENT_BITS - exponent;
+    if (shift < 0)
+    {
+        return;
+    }
+
+    shift = std::min(shift, LOSSLESS_MAX_SHIFT);
+
+    f64 carry = 0;
+    for (u32 i = 0; i < pOrder; i++)
+    {
+        f64 scaled = a[i] * (f64) (1 << shift) + carry;
+        s32 q      = (s32) std::lround(scaled);
+
+        q          = std::min(std::max(q, -(1 << LOSSLESS_COEFFICIENT_BITS)), (1 << LOSSLESS_COEFFICIENT_BITS) - 1);
+        carry      = scaled - q;
+        pCoeffs[i] = (s16) q;
+    }
+
+    pShift = shift;
+}
+
+void losslessEncodeFrame(const s16 *pSrc, size_t pCount, std::vector<u8> &pOut) {
+    u32 order    = std::min<size_t>(SFS_LOSSLESS_ORDER, pCount);
+    u32 rawBytes = pCount * SAMPLE_SIZE;
+    u32 rawBlocks = blocksFor(rawBytes);
+
+    std::array<s16, SFS_LOSSLESS_ORDER> coeffs;
+    u8                                  shift;
+    losslessCoefficients(pSrc, pCount, order, coeffs.data(), shift);
+
+    // zigzagged residuals, 0 for the warmup samples
+    std::array<u32, SFS_LOSSLESS_FRAME_SAMPLES> residuals = {};
+
+    bool usable = true;
+    for (size_t n = order; n < pCount; n++)
+    {
+        s32 acc = 0;
+        for (u32 j = 0; j < order; j++)
+        {
+            acc += coeffs[j] * pSrc[n - 1 - j];
+        }
+
+        s64 residual = pSrc[n] - (acc >> shift);
+        if (std::abs(residual) >= LOSSLESS_MAX_RESIDUAL)
+        {
+            usable = false;
+            break;
+        }
+
+        residuals[n] = ((u32) residual << 1) ^ (u32) (residual >> 63);
+    }
+
+    std::vector<u8> frame;
+    if (usable)
+    {
+        frame.reserve(rawBytes);
+        frame.push_back(order);
+        frame.push_back(shift);
+        frame.insert(frame.end(), (const u8 *) coeffs.data(), (const u8 *) (coeffs.data() + order));
+        frame.insert(frame.end(), (const u8 *) pSrc, (const u8 *) (pSrc + order));
+
+        LosslessBitWriter writer = {frame};
+        for (size_t first = 0; first < pCount; first += SFS_LOSSLESS_PARTITION_SAMPLES)
+        {
+            size_t begin = std::max<size_t>(first, order);
+            size_t end   = std::min<size_t>(first + SFS_LOSSLESS_PARTITION_SAMPLES, pCount);
+
+            // cost(k) = n * (k + 1) + sum(u >> k), the minimum is next to log2 of the mean
+            u64 sum = 0;
+            for (size_t n = begin; n < end; n++)
+            {
+                sum += residuals[n];
+            }
+
+            size_t n     = end > begin ? end - begin : 0;
+            u32    guess = n != 0 && sum / n != 0 ? 63 - __builtin_clzll(sum / n) : 0;
+            u32    best  = 0;
+            u64    cost  = ~0ull;
+            for (u32 k = guess == 0 ? 0 : guess - 1; k <= std::min<u32>(guess + 1, LOSSLESS_MAX_RICE); k++)
+            {
+                u64 bits = (u64) n * (k + 1);
+                for (size_t i = begin; i < end; i++)
+                {
+                    bits += residuals[i] >> k;
+                }
+
+                if (bits < cost)
+                {
+                    cost = bits;
+                    best = k;
+                }
+            }
+
+            writer.put(best, SFS_LOSSLESS_RICE_BITS);
+            for (size_t i = begin; i < end; i++)
+            {
+                writer.unary(residuals[i] >> best);
+                writer.put(residuals[i] & ((1u << best) - 1), best);
+            }
+        }
+
+        writer.flush();
+    }
+
+    // a frame that does not save a block is stored raw, which is also how the decoder tells the two apart
+    if (!usable || blocksFor(frame.size()) >= rawBlocks)
+    {
+        frame.assign((const u8 *) pSrc, (const u8 *) (pSrc + pCount));
+    }
+
+    pOut.insert(pOut.end(), frame.begin(), frame.end());
+    pOut.resize(pOut.size() + (BLOCK_SIZE - frame.size() % BLOCK_SIZE) % BLOCK_SIZE, 0);
+}
+
+void losslessAssemble(const std::vector<std::vector<u8> > &pFrames, std::vector<u8> &pOut) {
+    u32 indexBlocks = blocksFor(pFrames.size() * sizeof(u32));
+
+    size_t total = (size_t) indexBlocks * BLOCK_SIZE;
+    for (const auto &frame: pFrames)
+    {
+        total += frame.size();
+    }
+
+    pOut.assign(total, 0);
+
+    u32 block = indexBlocks;
+    u8 *dst   = pOut.data() + (size_t) indexBlocks * BLOCK_SIZE;
+    for (size_t i = 0; i < pFrames.size(); i++)
+    {
+        memcpy(pOut.data() + i * sizeof(u32), &block, sizeof(u32));
+        memcpy(dst, pFrames[i].data(), pFrames[i].size());
+
+        block += pFrames[i].size() / BLOCK_SIZE;
+        dst += pFrames[i].size();
+    }
+}
+
+void losslessEncode(const s16 *pSrc, size_t pCount, std::vector<u8> &pOut) {
+    std::vector<std::vector<u8> > frames(losslessFrameCount(pCount));
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+        size_t first = i * SFS_LOSSLESS_FRAME_SAMPLES;
+        losslessEncodeFrame(pSrc + first, std::min<size_t>(SFS_LOSSLESS_FRAME_SAMPLES, pCount - first), frames[i]);
+    }
+
+    losslessAssemble(frames, pOut);
+}
+
+bool losslessFrameBlocks(const u8 *pData, size_t pSize, size_t pCount, u32 pFrame, u32 &pStart, u32 &pBlocks) {
+    u32 frames      = losslessFrameCount(pCount);
+    u32 indexBlocks = losslessIndexBlocks(pCount);
+    u32 totalBlocks = pSize / BLOCK_SIZE;
+
+    if (pFrame >= frames || totalBlocks < indexBlocks)
+    {
+        return false;
+    }
+
+    u32 start, next = totalBlocks;
+    memcpy(&start, pData + (size_t) pFrame * sizeof(u32), sizeof(u32));
+    if (pFrame + 1 < frames)
+    {
+        memcpy(&next, pData + (size_t) (pFrame + 1) * sizeof(u32), sizeof(u32));
+    }
+
+    if (start < indexBlocks || next <= start || next > totalBlocks)
+    {
+        return false;
+    }
+
+    pStart  = start;
+    pBlocks = next - start;
+    return true;
+}
+
+// the rice pass and the prediction pass run one after the other, each is a tight loop with a single dependency chain
+// where interleaved they would stall each other. a well formed frame never overflows the accumulator (see
+// LOSSLESS_COEFFICIENT_BITS), a corrupt one wraps instead
+static void losslessPredict(const s32 *pResiduals, const s16 *pCoeffs, u8 pShift, s16 *pDst, size_t pCount, u32 pOrder) {
+    for (size_t n = pOrder; n < pCount; n++)
+    {
+        u32 acc = 0;
+        for (u32 j = 0; j < pOrder; j++)
+        {
+            acc += (u32) (pCoeffs[j] * pDst[n - 1 - j]);
+        }
+
+        pDst[n] = (s16) (pResiduals[n] + ((s32) acc >> pShift));
+    }
+}
+
+// every frame but a short last one, written out so the history stays in registers and only the newest sample's
+// product is on the critical path
+static void losslessPredictFull(const s32 *pResiduals, const s16 *pCoeffs, u8 pShift, s16 *pDst, size_t pCount) {
+    static_assert(SFS_LOSSLESS_ORDER == 8);
+
+    s32 c0 = pCoeffs[0], c1 = pCoeffs[1], c2 = pCoeffs[2], c3 = pCoeffs[3];
+    s32 c4 = pCoeffs[4], c5 = pCoeffs[5], c6 = pCoeffs[6], c7 = pCoeffs[7];
+    s32 x1 = pDst[7], x2 = pDst[6], x3 = pDst[5], x4 = pDst[4];
+    s32 x5 = pDst[3], x6 = pDst[2], x7 = pDst[1], x8 = pDst[0];
+
+    for (size_t n = SFS_LOSSLESS_ORDER; n < pCount; n++)
+    {
+        u32 older = (u32) (c1 * x2) + (u32) (c2 * x3) + (u32) (c3 * x4) + (u32) (c4 * x5) + (u32) (c5 * x6) +
+                    (u32) (c6 * x7) + (u32) (c7 * x8);
+        s32 x = (s16) (pResiduals[n] + ((s32) (older + (u32) (c0 * x1)) >> pShift));
+
+        x8 = x7;
+        x7 = x6;
+        x6 = x5;
+        x5 = x4;
+        x4 = x3;
+        x3 = x2;
+        x2 = x1;
+        x1 = x;
+
+        pDst[n] = (s16) x;
+    }
+}
+
+static void losslessResiduals(LosslessBitReader &pReader, s32 *pResiduals, size_t pCount, u32 pOrder) {
+    // a local copy the compiler can keep in registers
+    LosslessBitReader reader = pReader;
+
+    for (size_t first = 0; first < pCount; first += SFS_LOSSLESS_PARTITION_SAMPLES)
+    {
+        size_t begin = std::max<size_t>(first, pOrder);
+        size_t end   = std::min<size_t>(first + SFS_LOSSLESS_PARTITION_SAMPLES, pCount);
+        u32    k     = reader.read(SFS_LOSSLESS_RICE_BITS);
+
+        for (size_t n = begin; n < end; n++)
+        {
+            reader.refill();
+
+            u32 q = reader.unary();
+            u32 u = (q << k) | reader.read(k);
+
+            pResiduals[n] = (s32) (u >> 1) ^ -(s32) (u & 1);
+        }
+    }
+
+    pReader = reader;
+}
+
+bool losslessDecodeFrame(const u8 *pFrame, u32 pBlocks, s16 *pDst, size_t pCount) {
+    if (pCount == 0)
+    {
+        return true;
+    }
+
+    if (pCount > SFS_LOSSLESS_FRAME_SAMPLES)
+    {
+        return false;
+    }
+
+    if (pBlocks >= blocksFor(pCount * SAMPLE_SIZE))
+    {
+        memcpy(pDst, pFrame, pCount * SAMPLE_SIZE);
+        return true;
+    }
+
+    u32    order  = pFrame[0];
+    u8     shift  = pFrame[1];
+    size_t header = 2 + order * 2 * sizeof(s16);
+    if (order > SFS_LOSSLESS_ORDER || order > pCount || shift > LOSSLESS_MAX_SHIFT || header > (size_t) pBlocks * BLOCK_SIZE)
+    {
+        return false;
+    }
+
+    s16 coeffs[SFS_LOSSLESS_ORDER];
+    memcpy(coeffs, pFrame + 2, order * sizeof(s16));
+    memcpy(pDst, pFrame + 2 + order * sizeof(s16), order * sizeof(s16));
+
+    LosslessBitReader reader = {pFrame + header, pFrame + (size_t) pBlocks * BLOCK_SIZE};
+
+    std::array<s32, SFS_LOSSLESS_FRAME_SAMPLES> residuals;
+    losslessResiduals(reader, residuals.data(), pCount, order);
+    if (reader.overrun)
+    {
+        return false;
+    }
+
+    if (order == SFS_LOSSLESS_ORDER)
+    {
+        losslessPredictFull(residuals.data(), coeffs, shift, pDst, pCount);
+    }
+    else
+    {
+        losslessPredict(residuals.data(), coeffs, shift, pDst, pCount, order);
+    }
+
+    return true;
+}
+
+bool losslessDecode(const u8 *pData, size_t pSize, s16 *pDst, size_t pCount) {
+    u32 frames = losslessFrameCount(pCount);
+    for (u32 i = 0; i < frames; i++)
+    {
+        u32 start, blocks;
+        if (!losslessFrameBlocks(pData, pSize, pCount, i, start, blocks))
+        {
+            return false;
+        }
+
+        size_t first = (size_t) i * SFS_LOSSLESS_FRAME_SAMPLES;
+        size_t count = std::min<size_t>(SFS_LOSSLESS_FRAME_SAMPLES, pCount - first);
+        if (!losslessDecodeFrame(pData + (size_t) start * BLOCK_SIZE, blocks, pDst + first, count))
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
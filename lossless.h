@@ -0,0 +1,44 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef LOSSLESS_H
+#define LOSSLESS_H
+
+#include <cstddef>
+#include <vector>
+
+#include "types.h"
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+// frames of pCount samples, see SFS_LOSSLESS_FRAME_SAMPLES
+u32 losslessFrameCount(size_t pCount);
+
+// blocks of seek index in front of the frames
+u32 losslessIndexBlocks(size_t pCount);
+
+// encodes one frame (pCount <= SFS_LOSSLESS_FRAME_SAMPLES) into pOut, a whole number of blocks. frames are
+// independent, so mkimg encodes every frame of every sample side by side
+void losslessEncodeFrame(const s16 *pSrc, size_t pCount, std::vector<u8> &pOut);
+
+// the seek index of pFrames followed by the frames themselves, the stored form of a sample
+void losslessAssemble(const std::vector<std::vector<u8> > &pFrames, std::vector<u8> &pOut);
+
+// losslessEncodeFrame and losslessAssemble over a whole sample on the calling thread
+void losslessEncode(const s16 *pSrc, size_t pCount, std::vector<u8> &pOut);
+
+// first block and block count of frame pFrame from the seek index, false when the index points outside pSize bytes
+bool losslessFrameBlocks(const u8 *pData, size_t pSize, size_t pCount, u32 pFrame, u32 &pStart, u32 &pBlocks);
+
+// decodes the pCount (<= SFS_LOSSLESS_FRAME_SAMPLES) samples of the frame in pBlocks blocks at pFrame, false when
+// the frame is malformed
+bool losslessDecodeFrame(const u8 *pFrame, u32 pBlocks, s16 *pDst, size_t pCount);
+
+// decodes a whole stored sample of pSize bytes
+bool losslessDecode(const u8 *pData, size_t pSize, s16 *pDst, size_t pCount);
+
+#endif //LOSSLESS_H
@@ -3,9 +3,13 @@
 #include <format>
 
 #include "argparse.hpp"
+#include "bench.h"
+#include "block_cache.h"
 #include "binary_reader.h"
 #include "fs.h"
 #include "nki_extract.h"
+#include "proximity_table.h"
+#include "sd_sim.h"
 #include <tfd/tinyfiledialogs.h>
 
 #include "fill.h"
@@ -24,16 +28,88 @@ int main(int pArgc, char *pArgv[]) {
 
     argparse::ArgumentParser subMkImg("mkimg");
     subMkImg.add_argument("-i", "--instrument-folder");
+    subMkImg.add_argument("-j", "--jobs").default_value(std::string("1")).help("ingestion threads, 0 = all cores");
+    subMkImg.add_argument("--full").flag().help("rebuild from scratch instead of reusing the previous image");
+    subMkImg.add_argument("--direct").flag().help("write the image with O_DIRECT / unbuffered io");
+    subMkImg.add_argument("--layout").default_value(std::string("instrument")).choices("instrument", "velocity", "key", "trace");
+    subMkImg.add_argument("--trace").help("midi file the trace layout orders samples by");
+    subMkImg.add_argument("--trace-instrument").default_value(std::string("-1")).help("instrument playing the trace, -1 = midi channel");
+    subMkImg.add_argument("--allocation-unit").default_value(std::string("0")).help("bytes, samples at least this long start aligned to it");
+    subMkImg.add_argument("--metrics").help("json file to record per phase timings, byte counts and padding in");
+    subMkImg.add_argument("--crc-extent").default_value(std::string("1")).help("blocks per crc table entry, 0 leaves the table out");
+    subMkImg.add_argument("--proximity").default_value(std::string("full")).choices("full", "compact").help("proximity table encoding, compact needs firmware that reads proximityTableEncoding");
+    subMkImg.add_argument("--resident-budget").default_value(std::string("0")).help("bytes of device ram for whole samples loaded at boot");
+    subMkImg.add_argument("--attack-blocks").default_value(std::string("0")).help("blocks of every sample copied to the attack region, instruments can override it");
 
     argparse::ArgumentParser subFlash("flash");
 
     argparse::ArgumentParser subFill("fill");
     subFill.add_argument("-i", "--instrument-folder");
+    subFill.add_argument("-j", "--jobs").default_value(std::string("1")).help("worker threads, 0 = all cores");
+    subFill.add_argument("--interpolation").default_value(std::string("linear")).choices("linear", "cubic");
+    subFill.add_argument("--virtual").flag().help("store per key pitch offsets for the device instead of writing wavs");
+    subFill.add_argument("--plan").flag().help("report outputs, sizes and image growth without writing anything");
+    subFill.add_argument("--flash-rate").default_value(std::string("10")).help("MiB/s assumed for the --plan flash time");
+
+    argparse::ArgumentParser subEstimate("estimate");
+    subEstimate.add_argument("-m", "--midi").required().help("trace to replay against the image");
+    subEstimate.add_argument("-f", "--image").default_value(std::string("synth.bin"));
+    subEstimate.add_argument("--instrument").default_value(std::string("-1")).help("instrument playing the trace, -1 = midi channel");
+    subEstimate.add_argument("--attack-blocks").default_value(std::string("32")).help("blocks read when a voice starts");
+    subEstimate.add_argument("--chord-ms").default_value(std::string("10")).help("note ons this close are read as one batch");
+    subEstimate.add_argument("--merge-gap").default_value(std::string("8")).help("blocks read through rather than issuing a new command");
+
+    argparse::ArgumentParser subCache("cache");
+    subCache.add_argument("-m", "--midi").required().help("trace to replay through the cache");
+    subCache.add_argument("-f", "--image").default_value(std::string("synth.bin"));
+    subCache.add_argument("--policy").default_value(std::string("all")).choices("lru", "clock", "arc", "all");
+    subCache.add_argument("--capacity")
+            .nargs(argparse::nargs_pattern::at_least_one)
+            .default_value(std::vector<std::string>{"64", "256", "1024", "4096"})
+            .help("cache sizes to try, in blocks");
+    subCache.add_argument("--instrument").default_value(std::string("-1")).help("instrument playing the trace, -1 = midi channel");
+    subCache.add_argument("--attack-blocks").default_value(std::string("32")).help("blocks read when a voice starts");
+
+    argparse::ArgumentParser subSdSim("sdsim");
+    subSdSim.add_argument("-f", "--image").default_value(std::string("synth.bin"));
+    subSdSim.add_argument("-c", "--config").help("card timing json, the defaults model a 4 bit sdio card");
+    subSdSim.add_argument("-m", "--midi").help("voices play the samples this trace triggers instead of every sample in turn");
+    subSdSim.add_argument("--instrument").default_value(std::string("-1")).help("instrument playing the trace, -1 = midi channel");
+    subSdSim.add_argument("--buffer-blocks").default_value(std::string("16")).help("ring buffer per voice");
+    subSdSim.add_argument("--chunk-blocks").default_value(std::string("4")).help("blocks per refill command");
+    subSdSim.add_argument("--seconds").default_value(std::string("2")).help("playback simulated per voice count");
+    subSdSim.add_argument("--max-voices").default_value(std::string("256"));
+    subSdSim.add_argument("--timeline").help("csv of every command at the largest voice count that held up");
+    subSdSim.add_argument("--latency").flag().help("report note on latency with and without the preloaded regions instead");
+
+    argparse::ArgumentParser subExtract("extract");
+    subExtract.add_argument("-f", "--image").default_value(std::string("synth.bin"));
+    subExtract.add_argument("-o", "--output-folder").default_value(std::string("extracted"));
+    subExtract.add_argument("-j", "--jobs").default_value(std::string("0")).help("worker threads, 0 = all cores");
+
+    argparse::ArgumentParser subVerify("verify");
+    subVerify.add_argument("-f", "--image").default_value(std::string("synth.bin")).help("image file or raw device");
+    subVerify.add_argument("-j", "--jobs").default_value(std::string("0")).help("worker threads, 0 = all cores");
+
+    argparse::ArgumentParser subInspect("inspect");
+    subInspect.add_argument("-f", "--image").default_value(std::string("synth.bin"));
+
+    argparse::ArgumentParser subBench("bench");
+    subBench.add_argument("-w", "--workload").default_value(std::string("fill")).choices("fill", "analyze", "adpcm", "lossless");
+    subBench.add_argument("-i", "--instrument-folder").help("benchmark on real samples instead of generated ones");
+    subBench.add_argument("-n", "--iterations").default_value(std::string("5"));
 
     program.add_subparser(subExtractNki);
     program.add_subparser(subMkImg);
     program.add_subparser(subFlash);
     program.add_subparser(subFill);
+    program.add_subparser(subEstimate);
+    program.add_subparser(subCache);
+    program.add_subparser(subSdSim);
+    program.add_subparser(subExtract);
+    program.add_subparser(subVerify);
+    program.add_subparser(subInspect);
+    program.add_subparser(subBench);
 
     try
     {
@@ -57,7 +133,33 @@ int main(int pArgc, char *pArgv[]) {
         }
         else if (program.is_subcommand_used(subMkImg))
         {
-            ret = SynthFs::writeImage(subMkImg.get("--instrument-folder"));
+            ImageBuildOptions options;
+            options.jobs   = std::stoul(subMkImg.get("--jobs"));
+            options.full   = subMkImg.get<bool>("--full");
+            options.direct = subMkImg.get<bool>("--direct");
+
+            PcmLayout::parsePolicy(subMkImg.get("--layout"), options.layout);
+            options.traceInstrument = std::stoi(subMkImg.get("--trace-instrument"));
+            options.allocationUnit  = std::stoul(subMkImg.get("--allocation-unit"));
+            options.crcExtentBlocks = std::min<u32>(std::stoul(subMkImg.get("--crc-extent")), 0xFFFF);
+            options.attackBlocks    = std::min<u32>(std::stoul(subMkImg.get("--attack-blocks")), SFS_MAX_ATTACK_BLOCKS);
+            options.residentBudget  = std::stoull(subMkImg.get("--resident-budget"));
+            ProximityTable::parseEncoding(subMkImg.get("--proximity"), options.proximity);
+            if (subMkImg.is_used("--metrics"))
+            {
+                options.metrics = subMkImg.get("--metrics");
+            }
+
+            if (subMkImg.is_used("--trace"))
+            {
+                options.trace = subMkImg.get("--trace");
+            }
+            else if (options.layout == PCM_LAYOUT_TRACE)
+            {
+                throw std::runtime_error("--layout trace needs --trace");
+            }
+
+            ret = SynthFs::writeImage(subMkImg.get("--instrument-folder"), options);
         }
         else if (program.is_subcommand_used(subFlash))
         {
@@ -65,7 +167,219 @@ int main(int pArgc, char *pArgv[]) {
         }
         else if (program.is_subcommand_used(subFill))
         {
-            ret = Fill::fill(subFill.get("--instrument-folder"));
+            FillOptions options;
+            options.jobs         = std::stoul(subFill.get("--jobs"));
+            options.virtualFill  = subFill.get<bool>("--virtual");
+            options.plan         = subFill.get<bool>("--plan");
+            options.flashRateMiB = std::stod(subFill.get("--flash-rate"));
+            if (subFill.get("--interpolation") == "cubic")
+            {
+                options.interpolation = PCM_INTERPOLATION_CUBIC;
+            }
+
+            ret = Fill::fill(subFill.get("--instrument-folder"), options);
+        }
+        else if (program.is_subcommand_used(subEstimate))
+        {
+            SeekEstimateOptions options;
+            options.instrument     = std::stoi(subEstimate.get("--instrument"));
+            options.attackBlocks   = std::stoul(subEstimate.get("--attack-blocks"));
+            options.chordWindow    = std::stod(subEstimate.get("--chord-ms")) / 1000.0;
+            options.mergeGapBlocks = std::stoul(subEstimate.get("--merge-gap"));
+
+            std::vector<MidiNoteOn> notes;
+            SeekEstimate            estimate;
+
+            ret = MidiTrace::load(subEstimate.get("--midi"), notes);
+            if (ret == SERR_OK)
+            {
+                ret = PcmLayout::estimate(subEstimate.get("--image"), notes, options, estimate);
+            }
+
+            if (ret == SERR_OK)
+            {
+                printf("\t- Notes: %zu (%zu unmapped, %zu resident)\n", estimate.notes, estimate.unmapped, estimate.resident);
+                printf("\t- Read commands: %zu\n", estimate.commands);
+                printf("\t- Seeks: %zu\n", estimate.seeks);
+                printf("\t- Blocks read: %llu (%llu wanted)\n", (unsigned long long) estimate.blocksRead, (unsigned long long) estimate.blocksWanted);
+            }
+        }
+        else if (program.is_subcommand_used(subCache))
+        {
+            std::vector<blockCachePolicy> policies = {BLOCK_CACHE_LRU, BLOCK_CACHE_CLOCK, BLOCK_CACHE_ARC};
+            if (subCache.get("--policy") != "all")
+            {
+                policies.resize(1);
+                BlockCache::parsePolicy(subCache.get("--policy"), policies[0]);
+            }
+
+            std::vector<MidiNoteOn> notes;
+            SfsImage                image;
+
+            ret = MidiTrace::load(subCache.get("--midi"), notes);
+            if (ret == SERR_OK)
+            {
+                ret = image.open(subCache.get("--image"));
+            }
+
+            auto backend = [&](u8 *pData, u32 pBlock, u32 pCount) {
+                auto src = image.blocks(pBlock, pCount);
+                if (src.empty())
+                {
+                    return SERR_SD_READ_ERROR;
+                }
+
+                memcpy(pData, src.data(), src.size());
+                return SERR_OK;
+            };
+
+            const char *policyNames[] = {"lru", "clock", "arc"};
+            for (const auto &capacityStr: subCache.get<std::vector<std::string> >("--capacity"))
+            {
+                u32 capacity = std::stoul(capacityStr);
+                for (size_t i = 0; ret == SERR_OK && i < policies.size(); i++)
+                {
+                    BlockCache cache(policies[i], capacity, backend);
+
+                    ret = cache.replay(image, notes, std::stoi(subCache.get("--instrument")), std::stoul(subCache.get("--attack-blocks")));
+
+                    const auto &stats = cache.counters();
+                    u64         reads = stats.hits + stats.misses;
+
+                    printf("\t- %-5s %6u blocks (%7.1f KiB): %5.1f%% hits, %llu misses, %llu evictions, %llu commands\n", policyNames[policies[i]],
+                           capacity, capacity * BLOCK_SIZE / 1024.0, reads ? 100.0 * stats.hits / reads : 0.0, (unsigned long long) stats.misses,
+                           (unsigned long long) stats.evictions, (unsigned long long) stats.commands);
+                }
+            }
+        }
+        else if (program.is_subcommand_used(subSdSim))
+        {
+            SdSimConfig config;
+            SfsImage    image;
+
+            ret = image.open(subSdSim.get("--image"));
+            if (ret == SERR_OK && subSdSim.is_used("--config"))
+            {
+                ret = SdSimConfig::load(subSdSim.get("--config"), config);
+            }
+
+            // the latency report keeps when each note was played
+            std::vector<u32>         samples;
+            std::vector<SdSimNoteOn> noteOns;
+            if (ret == SERR_OK && subSdSim.is_used("--midi"))
+            {
+                std::vector<MidiNoteOn> notes;
+
+                ret = MidiTrace::load(subSdSim.get("--midi"), notes);
+
+                int  instrument = std::stoi(subSdSim.get("--instrument"));
+                auto tables     = image.proximityTables();
+                for (const auto &note: notes)
+                {
+                    size_t idx    = instrument < 0 ? note.channel : instrument;
+                    u32    sample = idx < tables.size() ? PcmLayout::resolveSample(tables[idx], note.key, note.velocity) : PCM_LAYOUT_NO_SAMPLE;
+                    if (sample != PCM_LAYOUT_NO_SAMPLE)
+                    {
+                        samples.push_back(sample);
+                        noteOns.push_back({note.time, sample});
+                    }
+                }
+            }
+            else if (ret == SERR_OK)
+            {
+                for (u32 i = 0; i < image.samples().size(); i++)
+                {
+                    samples.push_back(i);
+                    noteOns.push_back({i * SD_SIM_NOTE_SPACING, i});
+                }
+            }
+
+            if (ret == SERR_OK && samples.empty())
+            {
+                ret = SERR_CMD_INVALID_ARGUMENT;
+            }
+
+            VoiceStreamOptions options;
+            options.bufferBlocks = std::stoul(subSdSim.get("--buffer-blocks"));
+            options.chunkBlocks  = std::stoul(subSdSim.get("--chunk-blocks"));
+            options.seconds      = std::stod(subSdSim.get("--seconds"));
+
+            if (ret == SERR_OK && subSdSim.get<bool>("--latency"))
+            {
+                SdSimulator device(&image, config);
+
+                for (bool preload: {false, true})
+                {
+                    auto result = device.noteOnLatency(noteOns, preload, options);
+
+                    printf("\t- %-24s%llu notes, latency mean %.2f ms, max %.2f ms", preload ? "With preloaded regions:" : "Streaming only:",
+                           (unsigned long long) result.notes, result.meanLatency * 1e3, result.maxLatency * 1e3);
+                    if (preload)
+                    {
+                        printf(", %llu from ram (%llu resident, %llu late continuations), %.1f KiB preloaded in %.1f ms",
+                               (unsigned long long) result.fromRam, (unsigned long long) result.resident,
+                               (unsigned long long) result.lateContinuations, result.preloadBytes / 1024.0, result.preloadTime * 1e3);
+                    }
+                    printf("\n");
+                }
+
+                if (image.header().attackRegionBlockCount + image.header().residentRegionBlockCount == 0)
+                {
+                    printf("\nThe image has no preloaded regions, build it with --attack-blocks or --resident-budget.\n");
+                }
+            }
+            else if (ret == SERR_OK)
+            {
+                SdSimulator device(&image, config);
+
+                u32 maxVoices = std::stoul(subSdSim.get("--max-voices"));
+                u32 sustained = 0;
+
+                for (u32 voices = 1; voices <= maxVoices; voices++)
+                {
+                    auto result = device.streamVoices(samples, voices, options);
+                    if (result.underrun)
+                    {
+                        printf("\t- %u voices underrun after %.3f s\n", voices, result.underrunTime);
+                        break;
+                    }
+
+                    sustained = voices;
+                    printf("\t- %u voices: %llu commands, bus busy %.1f%%\n", voices, (unsigned long long) result.commands,
+                           100.0 * result.busyTime / options.seconds);
+                }
+
+                printf("\nSustains %u voices.\n", sustained);
+
+                if (sustained != 0 && subSdSim.is_used("--timeline"))
+                {
+                    device.setLogging(true);
+                    device.streamVoices(samples, sustained, options);
+                    device.saveTimeline(subSdSim.get("--timeline"));
+                }
+            }
+        }
+        else if (program.is_subcommand_used(subExtract))
+        {
+            ret = SynthFs::extractImage(subExtract.get("--image"), subExtract.get("--output-folder"), std::stoul(subExtract.get("--jobs")));
+        }
+        else if (program.is_subcommand_used(subVerify))
+        {
+            ret = SynthFs::verifyImage(subVerify.get("--image"), std::stoul(subVerify.get("--jobs")));
+        }
+        else if (program.is_subcommand_used(subInspect))
+        {
+            ret = SynthFs::inspectImage(subInspect.get("--image"));
+        }
+        else if (program.is_subcommand_used(subBench))
+        {
+            std::filesystem::path instrumentFolder;
+            if (subBench.is_used("--instrument-folder"))
+            {
+                instrumentFolder = subBench.get("--instrument-folder");
+            }
+
+            ret = Bench::run(subBench.get("--workload"), instrumentFolder, std::stoul(subBench.get("--iterations")));
         }
         else
         {
@@ -0,0 +1,174 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <cstring>
+#include <fstream>
+
+#include "json.hpp"
+
+#include "manifest.h"
+
+// json numbers go through doubles in some tools, so 64 bit hashes are stored as hex strings
+static std::string manifestHex(u64 pValue) {
+    char buf[17];
+    snprintf(buf, sizeof(buf), "%016llx", (unsigned long long) pValue);
+    return buf;
+}
+
+static u64 manifestUnhex(const nlohmann::json &pJson) {
+    return std::stoull(pJson.get<std::string>(), nullptr, 16);
+}
+
+std::filesystem::path ImageManifest::pathFor(const std::filesystem::path &pImage) {
+    auto ret = pImage;
+    ret += ".manifest.json";
+    return ret;
+}
+
+bool ImageManifest::load(const std::filesystem::path &pFile, ImageManifest &pManifest) {
+    std::ifstream in(pFile);
+    if (!in.is_open())
+    {
+        return false;
+    }
+
+    try
+    {
+        auto json = nlohmann::json::parse(in);
+        if (json["version"] != MANIFEST_VERSION)
+        {
+            return false;
+        }
+
+        auto &hdr = json["header"];
+
+        pManifest.header                              = {};
+        pManifest.header.magic                        = hdr["magic"];
+        pManifest.header.holdBehaviorDataStart        = hdr["holdBehaviorDataStart"];
+        pManifest.header.pcmDataBlockStart            = hdr["pcmDataBlockStart"];
+        pManifest.header.stringLutBlockStart          = hdr["stringLutBlockStart"];
+        pManifest.header.stringDataBlockStart         = hdr["stringDataBlockStart"];
+        pManifest.header.instrumentInfoDataBlockStart = hdr["instrumentInfoDataBlockStart"];
+        pManifest.header.sampleInfoBlockStart         = hdr["sampleInfoBlockStart"];
+        pManifest.header.proximityTableBlockStart     = hdr["proximityTableBlockStart"];
+        pManifest.header.instrumentCount              = hdr["instrumentCount"];
+        pManifest.header.singleInstrumentCount        = hdr["singleInstrumentCount"];
+        pManifest.header.multiInstrumentCount         = hdr["multiInstrumentCount"];
+        pManifest.header.holdBehaviourStride          = hdr["holdBehaviourStride"];
+        pManifest.header.crcTableBlockStart           = hdr["crcTableBlockStart"];
+        pManifest.header.crcExtentBlocks              = hdr["crcExtentBlocks"];
+        pManifest.header.attackRegionBlockStart       = hdr["attackRegionBlockStart"];
+        pManifest.header.attackRegionBlockCount       = hdr["attackRegionBlockCount"];
+        pManifest.header.residentRegionBlockStart     = hdr["residentRegionBlockStart"];
+        pManifest.header.residentRegionBlockCount     = hdr["residentRegionBlockCount"];
+        pManifest.header.proximityTableEncoding       = hdr["proximityTableEncoding"];
+
+        pManifest.imageSize = json["imageSize"];
+        pManifest.holdHash  = manifestUnhex(json["holdHash"]);
+
+        pManifest.instruments.clear();
+        for (auto &entry: json["instruments"])
+        {
+            ManifestInstrument instrument = {};
+
+            instrument.id              = entry["id"];
+            instrument.metaHash        = manifestUnhex(entry["metaHash"]);
+            instrument.pcmStamp        = manifestUnhex(entry["pcmStamp"]);
+            instrument.layoutHash      = manifestUnhex(entry["layoutHash"]);
+            instrument.sampleIdxOrigin = entry["sampleIdxOrigin"];
+            instrument.sampleCount     = entry["sampleCount"];
+            instrument.blockStart      = entry["blockStart"];
+            instrument.blockCount      = entry["blockCount"];
+
+            pManifest.instruments.push_back(instrument);
+        }
+    } catch (const nlohmann::json::exception &)
+    {
+        return false;
+    }
+
+    return true;
+}
+
+bool ImageManifest::save(const std::filesystem::path &pFile) const {
+    nlohmann::ordered_json json;
+
+    json["version"]   = MANIFEST_VERSION;
+    json["imageSize"] = imageSize;
+    json["holdHash"]  = manifestHex(holdHash);
+
+    // casting so json does not treat packed fields as references
+    json["header"] = {
+        {"magic", (u32) header.magic},
+        {"holdBehaviorDataStart", (u32) header.holdBehaviorDataStart},
+        {"pcmDataBlockStart", (u32) header.pcmDataBlockStart},
+        {"stringLutBlockStart", (u32) header.stringLutBlockStart},
+        {"stringDataBlockStart", (u32) header.stringDataBlockStart},
+        {"instrumentInfoDataBlockStart", (u32) header.instrumentInfoDataBlockStart},
+        {"sampleInfoBlockStart", (u32) header.sampleInfoBlockStart},
+        {"proximityTableBlockStart", (u32) header.proximityTableBlockStart},
+        {"instrumentCount", (u32) header.instrumentCount},
+        {"singleInstrumentCount", (u16) header.singleInstrumentCount},
+        {"multiInstrumentCount", (u16) header.multiInstrumentCount},
+        {"holdBehaviourStride", (u16) header.holdBehaviourStride},
+        {"crcTableBlockStart", (u32) header.crcTableBlockStart},
+        {"crcExtentBlocks", (u16) header.crcExtentBlocks},
+        {"attackRegionBlockStart", (u32) header.attackRegionBlockStart},
+        {"attackRegionBlockCount", (u32) header.attackRegionBlockCount},
+        {"residentRegionBlockStart", (u32) header.residentRegionBlockStart},
+        {"residentRegionBlockCount", (u32) header.residentRegionBlockCount},
+        {"proximityTableEncoding", (u8) header.proximityTableEncoding},
+    };
+
+    json["instruments"] = nlohmann::ordered_json::array();
+    for (const auto &instrument: instruments)
+    {
+        json["instruments"].push_back({
+            {"id", instrument.id},
+            {"metaHash", manifestHex(instrument.metaHash)},
+            {"pcmStamp", manifestHex(instrument.pcmStamp)},
+            {"layoutHash", manifestHex(instrument.layoutHash)},
+            {"sampleIdxOrigin", instrument.sampleIdxOrigin},
+            {"sampleCount", instrument.sampleCount},
+            {"blockStart", instrument.blockStart},
+            {"blockCount", instrument.blockCount},
+        });
+    }
+
+    std::ofstream out(pFile);
+    if (!out.is_open())
+    {
+        return false;
+    }
+
+    out << json.dump(4);
+    return out.good();
+}
+
+bool ImageManifest::sameLayout(const ImageManifest &pOther) const {
+    if (memcmp(&header, &pOther.header, sizeof(sfsHeader)) != 0 || imageSize != pOther.imageSize)
+    {
+        return false;
+    }
+
+    if (instruments.size() != pOther.instruments.size())
+    {
+        return false;
+    }
+
+    for (size_t i = 0; i < instruments.size(); i++)
+    {
+        const auto &a = instruments[i];
+        const auto &b = pOther.instruments[i];
+
+        if (a.id != b.id || a.layoutHash != b.layoutHash || a.sampleIdxOrigin != b.sampleIdxOrigin || a.sampleCount != b.sampleCount ||
+            a.blockStart != b.blockStart || a.blockCount != b.blockCount)
+        {
+            return false;
+        }
+    }
+
+    return true;
+}
@@ -0,0 +1,49 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef MANIFEST_H
+#define MANIFEST_H
+
+#include <filesystem>
+#include <string>
+#include <vector>
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+#define MANIFEST_VERSION 7
+
+struct ManifestInstrument {
+    std::string id;
+
+    u64 metaHash;   // instrument.json, loop jsons and the sample file names
+    u64 pcmStamp;   // size and mtime of every wav, cheap stand-in for hashing gigabytes of pcm
+    u64 layoutHash; // per sample block offsets and block counts, a wav can change length within its blocks
+
+    u32 sampleIdxOrigin;
+    u32 sampleCount;
+    u32 blockStart; // absolute, in image blocks
+    u32 blockCount;
+};
+
+// written next to synth.bin by every successful mkimg, tells the next run what it may leave untouched
+class ImageManifest {
+public:
+    sfsHeader                       header;
+    u64                             imageSize;
+    u64                             holdHash; // the hold behaviour rows resolved from hold.json
+    std::vector<ManifestInstrument> instruments;
+
+    static bool load(const std::filesystem::path &pFile, ImageManifest &pManifest);
+    bool        save(const std::filesystem::path &pFile) const;
+
+    // same sections at the same blocks and the same samples at the same offsets, so anything can be rewritten in place
+    bool sameLayout(const ImageManifest &pOther) const;
+
+    static std::filesystem::path pathFor(const std::filesystem::path &pImage);
+};
+
+#endif //MANIFEST_H
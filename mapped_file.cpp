@@ -0,0 +1,132 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "mapped_file.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::MappedFile() {
+    buf    = nullptr;
+    len    = 0;
+    opened = false;
+}
+
+MappedFile::MappedFile(const std::filesystem::path &pFile) : MappedFile() {
+    open(pFile);
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+MappedFile::MappedFile(MappedFile &&pOther) noexcept : MappedFile() {
+    *this = std::move(pOther);
+}
+
+MappedFile &MappedFile::operator=(MappedFile &&pOther) noexcept {
+    if (this == &pOther)
+    {
+        return *this;
+    }
+
+    close();
+
+    std::swap(buf, pOther.buf);
+    std::swap(len, pOther.len);
+    std::swap(opened, pOther.opened);
+
+    return *this;
+}
+
+// the mapping keeps the file's contents reachable on its own, so the file itself is closed again right away and
+// any number of files can stay mapped without running into the open file limit
+bool MappedFile::open(const std::filesystem::path &pFile) {
+    close();
+
+    #ifdef _WIN32
+    HANDLE file = CreateFileW(pFile.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+    if (file == INVALID_HANDLE_VALUE)
+    {
+        return false;
+    }
+
+    LARGE_INTEGER fileSize;
+    if (!GetFileSizeEx(file, &fileSize))
+    {
+        CloseHandle(file);
+        return false;
+    }
+
+    len = fileSize.QuadPart;
+    if (len != 0)
+    {
+        HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+        if (mapping)
+        {
+            buf = (const u8 *) MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+            CloseHandle(mapping);
+        }
+    }
+
+    CloseHandle(file);
+    #else
+    int fd = ::open(pFile.c_str(), O_RDONLY);
+    if (fd < 0)
+    {
+        return false;
+    }
+
+    struct stat st = {};
+    if (fstat(fd, &st) != 0)
+    {
+        ::close(fd);
+        return false;
+    }
+
+    len = st.st_size;
+    if (len != 0)
+    {
+        void *ptr = mmap(nullptr, len, PROT_READ, MAP_PRIVATE, fd, 0);
+        buf       = ptr == MAP_FAILED ? nullptr : (const u8 *) ptr;
+    }
+
+    ::close(fd);
+    #endif
+
+    // zero length files have nothing to map
+    if (len != 0 && !buf)
+    {
+        len = 0;
+        return false;
+    }
+
+    opened = true;
+    return true;
+}
+
+void MappedFile::close() {
+    if (buf)
+    {
+        #ifdef _WIN32
+        UnmapViewOfFile(buf);
+        #else
+        munmap((void *) buf, len);
+        #endif
+    }
+
+    buf    = nullptr;
+    len    = 0;
+    opened = false;
+}
@@ -0,0 +1,53 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <filesystem>
+
+#include "types.h"
+
+// read-only memory mapping of a whole file. the mapping is immutable once open, so a single MappedFile can be
+// shared between threads without locking. it holds no file descriptor, only the mapping.
+class MappedFile {
+private:
+    const u8 *buf;
+    u64       len;
+    bool      opened; // zero length files have no mapping but are still open
+
+public:
+    MappedFile();
+    explicit MappedFile(const std::filesystem::path &pFile);
+    ~MappedFile();
+
+    MappedFile(MappedFile &&pOther) noexcept;
+    MappedFile &operator=(MappedFile &&pOther) noexcept;
+
+    MappedFile(const MappedFile &)            = delete;
+    MappedFile &operator=(const MappedFile &) = delete;
+
+    bool open(const std::filesystem::path &pFile);
+    void close();
+
+    bool isOpen() const {
+        return opened;
+    }
+
+    const u8 *data() const {
+        return buf;
+    }
+
+    u64 size() const {
+        return len;
+    }
+
+    template<typename T>
+    const T *at(u64 pOffset) const {
+        return (const T *) (buf + pOffset);
+    }
+};
+
+#endif //MAPPED_FILE_H
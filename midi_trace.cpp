@@ -0,0 +1,222 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <algorithm>
+
+#include "midi_trace.h"
+
+#include "mapped_file.h"
+
+// chunk ids as read by the big endian cursor
+#define MIDI_MAGIC_HEADER magic('d', 'h', 'T', 'M')
+#define MIDI_MAGIC_TRACK magic('k', 'r', 'T', 'M')
+
+// bounds checked big endian cursor over one chunk, every read past the end sets failed and returns 0
+struct MidiCursor {
+    const u8 *data;
+    u64       len;
+    u64       pos;
+    bool      failed;
+
+    u32 be(int pBytes) {
+        if (pos + pBytes > len)
+        {
+            failed = true;
+            return 0;
+        }
+
+        u32 value = 0;
+        for (int i = 0; i < pBytes; i++)
+        {
+            value = value << 8 | data[pos++];
+        }
+
+        return value;
+    }
+
+    u32 varLen() {
+        u32 value = 0;
+        for (int i = 0; i < 4; i++)
+        {
+            u32 byte = be(1);
+            value    = value << 7 | (byte & 0x7F);
+            if (!(byte & 0x80))
+            {
+                return value;
+            }
+        }
+
+        failed = true;
+        return 0;
+    }
+
+    void skip(u64 pBytes) {
+        if (pos + pBytes > len)
+        {
+            failed = true;
+            pos    = len;
+            return;
+        }
+
+        pos += pBytes;
+    }
+};
+
+struct MidiTickNote {
+    u64 tick;
+    u8  channel;
+    u8  key;
+    u8  velocity;
+};
+
+static bool midiParseTrack(MidiCursor &pTrack, std::vector<MidiTickNote> &pNotes, std::vector<std::pair<u64, u32> > &pTempos) {
+    u64 tick          = 0;
+    u8  runningStatus = 0;
+
+    while (pTrack.pos < pTrack.len && !pTrack.failed)
+    {
+        tick += pTrack.varLen();
+
+        u8 status = pTrack.be(1);
+        if (status < 0x80)
+        {
+            // running status, the byte just read is already the first data byte
+            if (runningStatus == 0)
+            {
+                return false;
+            }
+
+            status = runningStatus;
+            pTrack.pos--;
+        }
+
+        if (status == 0xFF)
+        {
+            u8  type = pTrack.be(1);
+            u32 len  = pTrack.varLen();
+
+            if (type == 0x51 && len == 3)
+            {
+                pTempos.emplace_back(tick, pTrack.be(3));
+                continue;
+            }
+
+            if (type == 0x2F)
+            {
+                return !pTrack.failed;
+            }
+
+            pTrack.skip(len);
+            continue;
+        }
+
+        if (status == 0xF0 || status == 0xF7)
+        {
+            pTrack.skip(pTrack.varLen());
+            continue;
+        }
+
+        if (status >= 0xF0)
+        {
+            // system common and realtime messages do not belong in files
+            return false;
+        }
+
+        runningStatus = status;
+
+        u8 kind = status & 0xF0;
+        u8 a    = pTrack.be(1);
+        u8 b    = kind == 0xC0 || kind == 0xD0 ? 0 : pTrack.be(1);
+
+        if (kind == 0x90 && b != 0)
+        {
+            pNotes.push_back({tick, (u8) (status & 0x0F), a, b});
+        }
+    }
+
+    return !pTrack.failed;
+}
+
+synthErrno MidiTrace::load(const std::filesystem::path &pFile, std::vector<MidiNoteOn> &pNotes) {
+    pNotes.clear();
+
+    MappedFile file;
+    if (!file.open(pFile))
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    MidiCursor header = {file.data(), file.size(), 0, false};
+
+    u32 headerMagic = header.be(4);
+    u32 headerLen   = header.be(4);
+    if (headerMagic != MIDI_MAGIC_HEADER || headerLen < 6)
+    {
+        return SERR_SFS_INVALID_MIDI;
+    }
+
+    u16 format     = header.be(2);
+    u16 trackCount = header.be(2);
+    u16 division   = header.be(2);
+
+    // smpte time codes (top bit set) are not used by anything this tool is fed
+    if (header.failed || format > 1 || division == 0 || division & 0x8000)
+    {
+        return SERR_SFS_INVALID_MIDI;
+    }
+
+    std::vector<MidiTickNote>         notes;
+    std::vector<std::pair<u64, u32> > tempos;
+
+    MidiCursor chunks = {file.data(), file.size(), 8 + (u64) headerLen, false};
+    for (u16 track = 0; track < trackCount; )
+    {
+        u32 id  = chunks.be(4);
+        u32 len = chunks.be(4);
+        if (chunks.failed || chunks.pos + len > chunks.len)
+        {
+            return SERR_SFS_INVALID_MIDI;
+        }
+
+        // unknown chunk types must be skipped, they do not count as tracks
+        if (id == MIDI_MAGIC_TRACK)
+        {
+            MidiCursor body = {file.data() + chunks.pos, len, 0, false};
+            if (!midiParseTrack(body, notes, tempos))
+            {
+                return SERR_SFS_INVALID_MIDI;
+            }
+
+            track++;
+        }
+
+        chunks.skip(len);
+    }
+
+    std::ranges::stable_sort(notes, {}, &MidiTickNote::tick);
+    std::ranges::stable_sort(tempos, {}, &std::pair<u64, u32>::first);
+
+    // ticks to seconds, walking the tempo map alongside the notes
+    u64    tempoTick = 0;
+    u32    tempo     = MIDI_TRACE_DEFAULT_TEMPO;
+    f64    tempoTime = 0;
+    size_t tempoIdx  = 0;
+
+    for (const auto &note: notes)
+    {
+        while (tempoIdx < tempos.size() && tempos[tempoIdx].first <= note.tick)
+        {
+            tempoTime += (f64) (tempos[tempoIdx].first - tempoTick) * tempo / division / 1e6;
+            tempoTick = tempos[tempoIdx].first;
+            tempo     = tempos[tempoIdx].second;
+            tempoIdx++;
+        }
+
+        f64 time = tempoTime + (f64) (note.tick - tempoTick) * tempo / division / 1e6;
+        pNotes.push_back({time, note.channel, note.key, note.velocity});
+    }
+
+    return SERR_OK;
+}
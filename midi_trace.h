@@ -0,0 +1,34 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef MIDI_TRACE_H
+#define MIDI_TRACE_H
+
+#include <filesystem>
+#include <vector>
+
+#include "types.h"
+
+extern "C" {
+#include "synthinf/serrno.h"
+}
+
+#define MIDI_TRACE_DEFAULT_TEMPO 500000 // us per quarter note, 120 bpm
+
+struct MidiNoteOn {
+    f64 time; // seconds from the start of the file
+    u8  channel;
+    u8  key;
+    u8  velocity; // 1..127, note ons with velocity 0 are note offs and never reported
+};
+
+// the note ons of a standard midi file (format 0 or 1), merged over all tracks and sorted by time. only what the
+// layout tools need is decoded, everything else is skipped by length.
+class MidiTrace {
+public:
+    static synthErrno load(const std::filesystem::path &pFile, std::vector<MidiNoteOn> &pNotes);
+};
+
+#endif //MIDI_TRACE_H
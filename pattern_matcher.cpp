@@ -0,0 +1,749 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "pattern_matcher.h"
+
+#include <algorithm>
+
+struct PatternMatcher::Node {
+    enum Kind {
+        SET,    // one character out of chars
+        CONCAT, // children in order
+        ALT,    // any one of children
+        REPEAT, // children[0] between min and max times, max < 0 is unbounded
+        EMPTY,
+    };
+
+    Kind              kind = EMPTY;
+    std::bitset<256>  chars;
+    std::vector<Node> children;
+    int               min = 0;
+    int               max = 0;
+};
+
+// recursive descent over the ECMAScript subset, unsupported is set for anything outside it
+class PatternParser {
+private:
+    using Node = PatternMatcher::Node;
+
+    const std::string &src;
+    size_t             pos;
+
+    bool atEnd() const {
+        return pos >= src.size();
+    }
+
+    char peek() const {
+        return atEnd() ? 0 : src[pos];
+    }
+
+    static std::bitset<256> classEscape(char pEscape, bool &pKnown) {
+        std::bitset<256> set;
+        pKnown = true;
+
+        switch (pEscape)
+        {
+            case 'd':
+            case 'D':
+                for (int c = '0'; c <= '9'; c++)
+                {
+                    set.set(c);
+                }
+                break;
+
+            case 'w':
+            case 'W':
+                for (int c = 0; c < 256; c++)
+                {
+                    set[c] = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '_';
+                }
+                break;
+
+            case 's':
+            case 'S':
+                for (char c: {' ', '\t', '\n', '\r', '\f', '\v'})
+                {
+                    set.set((u8) c);
+                }
+                break;
+
+            default:
+                pKnown = false;
+                return set;
+        }
+
+        return pEscape >= 'A' && pEscape <= 'Z' ? ~set : set;
+    }
+
+    // a single escaped character, false for the escapes that are not one character (\b, \1, \c, \u, ...)
+    bool charEscape(char pEscape, u8 &pChar) {
+        switch (pEscape)
+        {
+            case 't': pChar = '\t'; return true;
+            case 'n': pChar = '\n'; return true;
+            case 'r': pChar = '\r'; return true;
+            case 'f': pChar = '\f'; return true;
+            case 'v': pChar = '\v'; return true;
+            case '0': pChar = 0; return true;
+            case 'x':
+            {
+                if (pos + 2 > src.size() || !isxdigit((u8) src[pos]) || !isxdigit((u8) src[pos + 1]))
+                {
+                    return false;
+                }
+
+                pChar = (u8) std::stoi(src.substr(pos, 2), nullptr, 16);
+                pos += 2;
+                return true;
+            }
+
+            default:
+                // identity escapes are only defined for punctuation
+                if (isalnum((u8) pEscape))
+                {
+                    return false;
+                }
+
+                pChar = pEscape;
+                return true;
+        }
+    }
+
+    bool parseClass(Node &pNode) {
+        bool negate = peek() == '^';
+        if (negate)
+        {
+            pos++;
+        }
+
+        std::bitset<256> set;
+        while (!atEnd() && peek() != ']')
+        {
+            u8 lo = src[pos++];
+            if (lo == '\\')
+            {
+                if (atEnd())
+                {
+                    return false;
+                }
+
+                bool known;
+                auto escaped = classEscape(src[pos], known);
+                if (known)
+                {
+                    pos++;
+                    set |= escaped;
+                    continue;
+                }
+
+                // \b is a backspace inside a class
+                char escape = src[pos++];
+                if (escape == 'b')
+                {
+                    lo = '\b';
+                }
+                else if (!charEscape(escape, lo))
+                {
+                    return false;
+                }
+            }
+
+            u8 hi = lo;
+            if (peek() == '-' && pos + 1 < src.size() && src[pos + 1] != ']')
+            {
+                pos++;
+                hi = src[pos++];
+                if (hi == '\\')
+                {
+                    if (atEnd() || !charEscape(src[pos++], hi))
+                    {
+                        return false;
+                    }
+                }
+
+                if (hi < lo)
+                {
+                    return false;
+                }
+            }
+
+            for (int c = lo; c <= hi; c++)
+            {
+                set.set(c);
+            }
+        }
+
+        if (atEnd())
+        {
+            return false;
+        }
+
+        pos++;
+
+        pNode.kind  = Node::SET;
+        pNode.chars = negate ? ~set : set;
+        return true;
+    }
+
+    bool parseAtom(Node &pNode) {
+        char c = src[pos++];
+
+        switch (c)
+        {
+            case '(':
+            {
+                if (peek() == '?')
+                {
+                    // only non-capturing groups, lookaround is not regular
+                    if (pos + 1 >= src.size() || src[pos + 1] != ':')
+                    {
+                        return false;
+                    }
+
+                    pos += 2;
+                }
+
+                if (!parseAlt(pNode) || peek() != ')')
+                {
+                    return false;
+                }
+
+                pos++;
+                return true;
+            }
+
+            case '[':
+                return parseClass(pNode);
+
+            case '.':
+                pNode.kind = Node::SET;
+                pNode.chars.set();
+                pNode.chars.reset('\n');
+                pNode.chars.reset('\r');
+                return true;
+
+            case '\\':
+            {
+                if (atEnd())
+                {
+                    return false;
+                }
+
+                bool known;
+                pNode.chars = classEscape(src[pos], known);
+                pNode.kind  = Node::SET;
+                if (known)
+                {
+                    pos++;
+                    return true;
+                }
+
+                u8 ch;
+                if (!charEscape(src[pos++], ch))
+                {
+                    return false;
+                }
+
+                pNode.chars.set(ch);
+                return true;
+            }
+
+            // regex_match anchors both ends anyway, so leading ^ and trailing $ change nothing
+            case '^':
+                pNode.kind = Node::EMPTY;
+                return pos == 1;
+
+            case '$':
+                pNode.kind = Node::EMPTY;
+                return atEnd();
+
+            case '*':
+            case '+':
+            case '?':
+            case '{':
+            case ')':
+            case ']':
+            case '}':
+            case '|':
+                return false;
+
+            default:
+                pNode.kind = Node::SET;
+                pNode.chars.set((u8) c);
+                return true;
+        }
+    }
+
+    bool parseQuantifier(int &pMin, int &pMax) {
+        char c = peek();
+        if (c == '*' || c == '+' || c == '?')
+        {
+            pos++;
+            pMin = c == '+' ? 1 : 0;
+            pMax = c == '?' ? 1 : -1;
+        }
+        else
+        {
+            // {n}, {n,} or {n,m}
+            size_t end = src.find('}', pos);
+            if (end == std::string::npos)
+            {
+                return false;
+            }
+
+            std::string body  = src.substr(pos + 1, end - pos - 1);
+            size_t      comma = body.find(',');
+
+            auto number = [](const std::string &pStr, int &pOut) {
+                if (pStr.empty() || pStr.size() > 6 || !std::ranges::all_of(pStr, [](char ch) { return isdigit((u8) ch); }))
+                {
+                    return false;
+                }
+
+                pOut = std::stoi(pStr);
+                return true;
+            };
+
+            if (comma == std::string::npos)
+            {
+                if (!number(body, pMin))
+                {
+                    return false;
+                }
+
+                pMax = pMin;
+            }
+            else
+            {
+                if (!number(body.substr(0, comma), pMin))
+                {
+                    return false;
+                }
+
+                pMax = -1;
+                if (comma + 1 < body.size() && !number(body.substr(comma + 1), pMax))
+                {
+                    return false;
+                }
+            }
+
+            if (pMax >= 0 && pMax < pMin)
+            {
+                return false;
+            }
+
+            pos = end + 1;
+        }
+
+        // lazy quantifiers only change which match is found, not whether there is one
+        if (peek() == '?')
+        {
+            pos++;
+        }
+
+        return true;
+    }
+
+    bool parseConcat(Node &pNode) {
+        pNode.kind = Node::CONCAT;
+
+        while (!atEnd() && peek() != '|' && peek() != ')')
+        {
+            Node atom;
+            if (!parseAtom(atom))
+            {
+                return false;
+            }
+
+            while (peek() == '*' || peek() == '+' || peek() == '?' || peek() == '{')
+            {
+                Node repeat;
+                repeat.kind = Node::REPEAT;
+                if (!parseQuantifier(repeat.min, repeat.max) || repeat.min > PATTERN_MATCHER_MAX_REPEAT ||
+                    repeat.max > PATTERN_MATCHER_MAX_REPEAT)
+                {
+                    return false;
+                }
+
+                repeat.children.push_back(std::move(atom));
+                atom = std::move(repeat);
+            }
+
+            pNode.children.push_back(std::move(atom));
+        }
+
+        return true;
+    }
+
+    bool parseAlt(Node &pNode) {
+        Node first;
+        if (!parseConcat(first))
+        {
+            return false;
+        }
+
+        if (peek() != '|')
+        {
+            pNode = std::move(first);
+            return true;
+        }
+
+        pNode.kind = Node::ALT;
+        pNode.children.push_back(std::move(first));
+
+        while (peek() == '|')
+        {
+            pos++;
+
+            Node next;
+            if (!parseConcat(next))
+            {
+                return false;
+            }
+
+            pNode.children.push_back(std::move(next));
+        }
+
+        return true;
+    }
+
+public:
+    explicit PatternParser(const std::string &pSrc) : src(pSrc), pos(0) {}
+
+    bool parse(Node &pNode) {
+        return parseAlt(pNode) && atEnd();
+    }
+};
+
+u32 PatternMatcher::addState(bool pEpsilon) {
+    NfaState state = {};
+    state.out      = PATTERN_NO_STATE;
+    state.outAlt   = PATTERN_NO_STATE;
+    state.pattern  = -1;
+    state.epsilon  = pEpsilon;
+
+    nfa.push_back(state);
+    return nfa.size() - 1;
+}
+
+void PatternMatcher::patch(const std::vector<std::pair<u32, bool> > &pOut, u32 pTarget) {
+    for (const auto &[state, alt]: pOut)
+    {
+        (alt ? nfa[state].outAlt : nfa[state].out) = pTarget;
+    }
+}
+
+bool PatternMatcher::compileNode(const Node &pNode, u32 &pIn, std::vector<std::pair<u32, bool> > &pOut) {
+    switch (pNode.kind)
+    {
+        case Node::SET:
+        {
+            pIn              = addState(false);
+            nfa[pIn].chars   = pNode.chars;
+            pOut             = {{pIn, false}};
+            return true;
+        }
+
+        case Node::EMPTY:
+        {
+            pIn  = addState(true);
+            pOut = {{pIn, false}};
+            return true;
+        }
+
+        case Node::CONCAT:
+        {
+            if (pNode.children.empty())
+            {
+                return compileNode(Node(), pIn, pOut);
+            }
+
+            std::vector<std::pair<u32, bool> > prevOut;
+            for (size_t i = 0; i < pNode.children.size(); i++)
+            {
+                u32                                in;
+                std::vector<std::pair<u32, bool> > out;
+                compileNode(pNode.children[i], in, out);
+
+                if (i == 0)
+                {
+                    pIn = in;
+                }
+                else
+                {
+                    patch(prevOut, in);
+                }
+
+                prevOut = std::move(out);
+            }
+
+            pOut = std::move(prevOut);
+            return true;
+        }
+
+        case Node::ALT:
+        {
+            pOut.clear();
+
+            u32 prevSplit = PATTERN_NO_STATE;
+            for (size_t i = 0; i < pNode.children.size(); i++)
+            {
+                u32                                in;
+                std::vector<std::pair<u32, bool> > out;
+                compileNode(pNode.children[i], in, out);
+                pOut.insert(pOut.end(), out.begin(), out.end());
+
+                // a chain of splits, the last branch hangs off the alt edge of the one before it
+                u32 entry = in;
+                if (i + 1 < pNode.children.size())
+                {
+                    entry          = addState(true);
+                    nfa[entry].out = in;
+                }
+
+                if (prevSplit == PATTERN_NO_STATE)
+                {
+                    pIn = entry;
+                }
+                else
+                {
+                    nfa[prevSplit].outAlt = entry;
+                }
+
+                prevSplit = entry;
+            }
+
+            return true;
+        }
+
+        case Node::REPEAT:
+        {
+            const Node &child = pNode.children[0];
+
+            // the mandatory copies first, then either a loop or the optional copies nested in each other
+            Node sequence;
+            sequence.kind = Node::CONCAT;
+            for (int i = 0; i < pNode.min; i++)
+            {
+                sequence.children.push_back(child);
+            }
+
+            u32                                in;
+            std::vector<std::pair<u32, bool> > out;
+            compileNode(sequence, in, out);
+            pIn = in;
+
+            if (pNode.max < 0)
+            {
+                u32 split = addState(true);
+                patch(out, split);
+
+                u32                                childIn;
+                std::vector<std::pair<u32, bool> > childOut;
+                compileNode(child, childIn, childOut);
+
+                nfa[split].out = childIn;
+                patch(childOut, split);
+
+                pOut = {{split, true}};
+                return true;
+            }
+
+            pOut.clear();
+            for (int i = pNode.min; i < pNode.max; i++)
+            {
+                u32 split = addState(true);
+                patch(out, split);
+
+                u32                                childIn;
+                std::vector<std::pair<u32, bool> > childOut;
+                compileNode(child, childIn, childOut);
+
+                nfa[split].out = childIn;
+                pOut.emplace_back(split, true);
+
+                out = std::move(childOut);
+            }
+
+            pOut.insert(pOut.end(), out.begin(), out.end());
+            return true;
+        }
+    }
+
+    return false;
+}
+
+size_t PatternMatcher::add(const std::string &pPattern) {
+    Node       root;
+    bool       parsed = PatternParser(pPattern).parse(root);
+    std::regex fallback;
+
+    // std::regex throws here for patterns that are simply invalid, exactly as the old per-instrument loop did
+    if (!parsed)
+    {
+        fallback = std::regex(pPattern);
+    }
+
+    size_t idx = patterns.size();
+    patterns.push_back(pPattern);
+    usesFallback.push_back(!parsed);
+    fallbacks.push_back(std::move(fallback));
+
+    if (!parsed)
+    {
+        return idx;
+    }
+
+    u32                                in;
+    std::vector<std::pair<u32, bool> > out;
+    compileNode(root, in, out);
+
+    u32 accept            = addState(false);
+    nfa[accept].pattern   = idx;
+    patch(out, accept);
+
+    starts.push_back(in);
+    resetDfa();
+
+    return idx;
+}
+
+void PatternMatcher::closure(std::vector<u32> &pStates) const {
+    std::vector<u32>  stack(pStates.begin(), pStates.end());
+    std::vector<bool> seen(nfa.size(), false);
+
+    pStates.clear();
+    while (!stack.empty())
+    {
+        u32 state = stack.back();
+        stack.pop_back();
+
+        if (state == PATTERN_NO_STATE || seen[state])
+        {
+            continue;
+        }
+
+        seen[state] = true;
+
+        if (nfa[state].epsilon)
+        {
+            stack.push_back(nfa[state].out);
+            stack.push_back(nfa[state].outAlt);
+        }
+        else
+        {
+            pStates.push_back(state);
+        }
+    }
+
+    std::ranges::sort(pStates);
+}
+
+void PatternMatcher::resetDfa() {
+    dfa.clear();
+    dfaIndex.clear();
+}
+
+u32 PatternMatcher::dfaState(std::vector<u32> &&pStates) {
+    auto it = dfaIndex.find(pStates);
+    if (it != dfaIndex.end())
+    {
+        return it->second;
+    }
+
+    DfaState state;
+    state.next.fill(-1);
+
+    for (u32 nfaState: pStates)
+    {
+        if (nfa[nfaState].pattern >= 0)
+        {
+            state.accepts.push_back(nfa[nfaState].pattern);
+        }
+    }
+
+    std::ranges::sort(state.accepts);
+
+    state.nfaStates = std::move(pStates);
+    dfaIndex.emplace(state.nfaStates, dfa.size());
+    dfa.push_back(std::move(state));
+
+    return dfa.size() - 1;
+}
+
+void PatternMatcher::match(std::string_view pText, std::vector<u32> &pMatches) {
+    pMatches.clear();
+
+    if (!starts.empty())
+    {
+        if (dfa.empty())
+        {
+            std::vector<u32> initial = starts;
+            closure(initial);
+            dfaState(std::move(initial));
+        }
+
+        u32 current = 0;
+        for (char ch: pText)
+        {
+            u8  c    = ch;
+            s32 next = dfa[current].next[c];
+
+            if (next < 0)
+            {
+                std::vector<u32> states;
+                for (u32 nfaState: dfa[current].nfaStates)
+                {
+                    if (nfa[nfaState].chars[c])
+                    {
+                        states.push_back(nfa[nfaState].out);
+                    }
+                }
+
+                closure(states);
+
+                // a pathological set of patterns can blow the dfa up, start the cache over from here
+                if (dfa.size() >= PATTERN_MATCHER_MAX_DFA_STATES)
+                {
+                    resetDfa();
+
+                    std::vector<u32> initial = starts;
+                    closure(initial);
+                    dfaState(std::move(initial));
+
+                    next = dfaState(std::move(states));
+                }
+                else
+                {
+                    next                 = dfaState(std::move(states));
+                    dfa[current].next[c] = next;
+                }
+            }
+
+            current = next;
+            if (dfa[current].nfaStates.empty())
+            {
+                break;
+            }
+        }
+
+        pMatches = dfa[current].accepts;
+    }
+
+    bool addedFallback = false;
+    for (size_t i = 0; i < patterns.size(); i++)
+    {
+        if (usesFallback[i] && std::regex_match(pText.begin(), pText.end(), fallbacks[i]))
+        {
+            pMatches.push_back(i);
+            addedFallback = true;
+        }
+    }
+
+    if (addedFallback)
+    {
+        std::ranges::sort(pMatches);
+    }
+}
@@ -0,0 +1,85 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef PATTERN_MATCHER_H
+#define PATTERN_MATCHER_H
+
+#include <array>
+#include <bitset>
+#include <map>
+#include <regex>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "types.h"
+
+#define PATTERN_MATCHER_MAX_DFA_STATES 4096 // the transition cache is dropped and rebuilt past this
+#define PATTERN_MATCHER_MAX_REPEAT 256      // larger {n,m} counts go to the fallback instead of being unrolled
+#define PATTERN_NO_STATE 0xFFFFFFFFu
+
+// matches a string against many ECMAScript patterns at once, with std::regex_match semantics (the whole string has to
+// match). the patterns are compiled into one NFA that a lazily built DFA walks, so matching costs one table lookup
+// per character no matter how many patterns there are. the regex subset covered is what ids get matched with:
+// literals, ., classes, \d \w \s, groups, | and the usual quantifiers. anything else (backreferences, lookaround,
+// \b) keeps working through a std::regex fallback for just that pattern.
+class PatternMatcher {
+private:
+    struct Node; // parsed pattern, see pattern_matcher.cpp
+    friend class PatternParser;
+
+    struct NfaState {
+        std::bitset<256> chars; // consumes one of these and moves to out
+        u32              out;
+        u32              outAlt;  // second epsilon edge, or PATTERN_NO_STATE
+        s32              pattern; // >= 0 on the accepting state of that pattern
+        bool             epsilon; // out (and outAlt) are taken without consuming
+    };
+
+    struct DfaState {
+        std::vector<u32>     nfaStates; // sorted, the key of this state
+        std::vector<u32>     accepts;   // patterns matched when the input ends here
+        std::array<s32, 256> next;      // -1 until computed
+    };
+
+    std::vector<std::string> patterns;
+    std::vector<bool>        usesFallback;
+    std::vector<std::regex>  fallbacks; // indexed like patterns, only built where usesFallback
+
+    std::vector<NfaState> nfa;
+    std::vector<u32>      starts;
+
+    std::vector<DfaState>           dfa;
+    std::map<std::vector<u32>, u32> dfaIndex;
+
+    // thompson construction, pOut collects the (state, alt edge) pairs still to be pointed at what follows
+    bool compileNode(const Node &pNode, u32 &pIn, std::vector<std::pair<u32, bool> > &pOut);
+    void patch(const std::vector<std::pair<u32, bool> > &pOut, u32 pTarget);
+    u32  addState(bool pEpsilon);
+    void closure(std::vector<u32> &pStates) const;
+    void resetDfa();
+    u32  dfaState(std::vector<u32> &&pStates);
+
+public:
+    // returns the pattern's index. throws std::regex_error for patterns std::regex would reject too
+    size_t add(const std::string &pPattern);
+
+    // indices of every pattern matching the whole of pText, ascending
+    void match(std::string_view pText, std::vector<u32> &pMatches);
+
+    size_t size() const {
+        return patterns.size();
+    }
+
+    const std::string &pattern(size_t pIdx) const {
+        return patterns[pIdx];
+    }
+
+    bool isFallback(size_t pIdx) const {
+        return usesFallback[pIdx];
+    }
+};
+
+#endif //PATTERN_MATCHER_H
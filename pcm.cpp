@@ -3,8 +3,17 @@
 // Copyright (c) 2025 lovro. All rights reserved.
 //
 
+#include <algorithm>
+#include <array>
+#include <cmath>
+
 #include "pcm.h"
 
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#include <immintrin.h>
+#define PCM_X86_SIMD
+#endif
+
 f64 lerp(f64 a, f64 b, f64 t) {
     return a + (b - a) * t;
 }
@@ -31,3 +40,333 @@ void pcmResample(std::vector<s16> pPcmData, int pSampleRateIn, std::vector<s16>
         t += step;
     }
 }
+
+static const auto gPcmSemitoneRatios = [] {
+    std::array<f64, PCM_SEMITONE_TABLE_RANGE * 2 + 1> table = {};
+    for (int i = 0; i < (int) table.size(); ++i)
+    {
+        table[i] = std::pow(2.0, (i - PCM_SEMITONE_TABLE_RANGE) / 12.0);
+    }
+
+    return table;
+}();
+
+f64 pcmSemitoneRatio(int pSemitones) {
+    if (pSemitones < -PCM_SEMITONE_TABLE_RANGE || pSemitones > PCM_SEMITONE_TABLE_RANGE)
+    {
+        return std::pow(2.0, pSemitones / 12.0);
+    }
+
+    return gPcmSemitoneRatios[pSemitones + PCM_SEMITONE_TABLE_RANGE];
+}
+
+size_t pcmPitchShiftLength(size_t pSrcCount, int pSemitones) {
+    return (size_t) round(pSrcCount * pcmSemitoneRatio(-pSemitones));
+}
+
+// positions are 32.32 fixed point source indices, the fraction is narrowed to 15 bits so (b - a) * frac fits an s32
+static inline s16 pcmLerpFixed(const s16 *pSrc, size_t pSrcCount, u64 pPos) {
+    size_t idx = pPos >> 32;
+    if (idx >= pSrcCount - 1)
+    {
+        return pSrc[pSrcCount - 1];
+    }
+
+    s32 a    = pSrc[idx];
+    s32 b    = pSrc[idx + 1];
+    s32 frac = (s32) ((u32) pPos >> 17);
+
+    return (s16) (a + (((b - a) * frac + 0x4000) >> 15));
+}
+
+static inline s16 pcmCubic(const s16 *pSrc, size_t pSrcCount, u64 pPos) {
+    size_t idx  = pPos >> 32;
+    size_t last = pSrcCount - 1;
+
+    f32 p0 = pSrc[idx == 0 ? 0 : idx - 1];
+    f32 p1 = pSrc[std::min(idx, last)];
+    f32 p2 = pSrc[std::min(idx + 1, last)];
+    f32 p3 = pSrc[std::min(idx + 2, last)];
+    f32 t  = (f32) (s32) ((u32) pPos >> 8) * (1.0f / 16777216.0f);
+
+    f32 y = p1 + 0.5f * t * (p2 - p0 + t * (2.0f * p0 - 5.0f * p1 + 4.0f * p2 - p3 + t * (3.0f * (p1 - p2) + p3 - p0)));
+
+    // overshoot is possible on steep edges
+    s32 out = (s32) (y + (y < 0.0f ? -0.5f : 0.5f));
+    return (s16) std::min(std::max(out, -32768), 32767);
+}
+
+#ifdef PCM_X86_SIMD
+
+// 8 outputs per iteration. every lane gathers one dword at pSrc + idx, which holds both pSrc[idx] and pSrc[idx + 1],
+// so the caller must only pass outputs whose idx + 1 is still inside the source. returns how many were written.
+__attribute__((target("avx2")))
+static size_t pcmPitchShiftLinearAvx2(const s16 *pSrc, s16 *pDst, size_t pCount, u64 pStep) {
+    alignas(32) u32 baseIdx[8];
+    alignas(32) u32 baseFrac[8];
+
+    for (int k = 0; k < 8; ++k)
+    {
+        u64 pos     = k * pStep;
+        baseIdx[k]  = (u32) (pos >> 32);
+        baseFrac[k] = (u32) pos;
+    }
+
+    u64 inc = 8 * pStep;
+
+    __m256i idx     = _mm256_load_si256((const __m256i *) baseIdx);
+    __m256i frac    = _mm256_load_si256((const __m256i *) baseFrac);
+    __m256i incIdx  = _mm256_set1_epi32((s32) (u32) (inc >> 32));
+    __m256i incFrac = _mm256_set1_epi32((s32) (u32) inc);
+    __m256i bias    = _mm256_set1_epi32((s32) 0x80000000);
+    __m256i half    = _mm256_set1_epi32(0x4000);
+
+    size_t j = 0;
+    for (; j + 8 <= pCount; j += 8)
+    {
+        __m256i pair = _mm256_i32gather_epi32((const int *) pSrc, idx, 2);
+        __m256i a    = _mm256_srai_epi32(_mm256_slli_epi32(pair, 16), 16);
+        __m256i b    = _mm256_srai_epi32(pair, 16);
+        __m256i f    = _mm256_srli_epi32(frac, 17);
+
+        __m256i delta = _mm256_mullo_epi32(_mm256_sub_epi32(b, a), f);
+        __m256i out   = _mm256_add_epi32(a, _mm256_srai_epi32(_mm256_add_epi32(delta, half), 15));
+
+        // packs works per 128 bit lane, pick qwords 0 and 2 to get the 8 results in order
+        __m256i packed = _mm256_permute4x64_epi64(_mm256_packs_epi32(out, out), 0x08);
+        _mm_storeu_si128((__m128i *) (pDst + j), _mm256_castsi256_si128(packed));
+
+        // 64 bit position add split over idx/frac, avx2 has no unsigned compare so the carry is found with a bias
+        __m256i nextFrac = _mm256_add_epi32(frac, incFrac);
+        __m256i carry    = _mm256_cmpgt_epi32(_mm256_xor_si256(frac, bias), _mm256_xor_si256(nextFrac, bias));
+
+        idx  = _mm256_sub_epi32(_mm256_add_epi32(idx, incIdx), carry);
+        frac = nextFrac;
+    }
+
+    return j;
+}
+
+#endif
+
+#ifdef PCM_X86_SIMD
+
+// 16 samples per iteration. sums and absolute sums stay in 32 bit lanes for a bounded run of iterations before being
+// widened, squares (up to 2^31 per pair) are widened every time
+__attribute__((target("avx2")))
+static size_t pcmAnalyzeAvx2(const s16 *pSrc, size_t pCount, PcmStats &pStats) {
+    constexpr size_t runLength = 4096;
+
+    __m256i ones    = _mm256_set1_epi16(1);
+    __m256i zero    = _mm256_setzero_si256();
+    __m256i peak    = zero;
+    __m256i squares = zero;
+    __m256i sums    = zero;
+    __m256i abses   = zero;
+
+    size_t j = 0;
+    while (j + 16 <= pCount)
+    {
+        __m256i runSum = zero;
+        __m256i runAbs = zero;
+
+        size_t runEnd = std::min(pCount & ~(size_t) 15, j + runLength * 16);
+        for (; j < runEnd; j += 16)
+        {
+            __m256i x   = _mm256_loadu_si256((const __m256i *) (pSrc + j));
+            __m256i abs = _mm256_abs_epi16(x); // -32768 stays 0x8000, which is right read as unsigned
+
+            peak   = _mm256_max_epu16(peak, abs);
+            runSum = _mm256_add_epi32(runSum, _mm256_madd_epi16(x, ones));
+            runAbs = _mm256_add_epi32(runAbs, _mm256_unpacklo_epi16(abs, zero));
+            runAbs = _mm256_add_epi32(runAbs, _mm256_unpackhi_epi16(abs, zero));
+
+            __m256i sq = _mm256_madd_epi16(x, x);
+            squares    = _mm256_add_epi64(squares, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(sq)));
+            squares    = _mm256_add_epi64(squares, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(sq, 1)));
+        }
+
+        sums  = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_castsi256_si128(runSum)));
+        sums  = _mm256_add_epi64(sums, _mm256_cvtepi32_epi64(_mm256_extracti128_si256(runSum, 1)));
+        abses = _mm256_add_epi64(abses, _mm256_cvtepu32_epi64(_mm256_castsi256_si128(runAbs)));
+        abses = _mm256_add_epi64(abses, _mm256_cvtepu32_epi64(_mm256_extracti128_si256(runAbs, 1)));
+    }
+
+    alignas(32) u64 lanes64[4];
+    alignas(32) u16 lanes16[16];
+
+    _mm256_store_si256((__m256i *) lanes64, squares);
+    pStats.sumSquares += lanes64[0] + lanes64[1] + lanes64[2] + lanes64[3];
+
+    _mm256_store_si256((__m256i *) lanes64, sums);
+    pStats.sum += (s64) (lanes64[0] + lanes64[1] + lanes64[2] + lanes64[3]);
+
+    _mm256_store_si256((__m256i *) lanes64, abses);
+    pStats.sumAbs += lanes64[0] + lanes64[1] + lanes64[2] + lanes64[3];
+
+    _mm256_store_si256((__m256i *) lanes16, peak);
+    for (u16 lane: lanes16)
+    {
+        pStats.peak = std::max<u32>(pStats.peak, lane);
+    }
+
+    pStats.count += j;
+
+    return j;
+}
+
+#endif
+
+void pcmAnalyzeScalar(const s16 *pSrc, size_t pCount, PcmStats &pStats) {
+    for (size_t i = 0; i < pCount; ++i)
+    {
+        s32 x   = pSrc[i];
+        u32 abs = x < 0 ? -x : x;
+
+        pStats.sumAbs += abs;
+        pStats.sumSquares += (u64) (x * x);
+        pStats.sum += x;
+        pStats.peak = std::max(pStats.peak, abs);
+    }
+
+    pStats.count += pCount;
+}
+
+void pcmAnalyze(const s16 *pSrc, size_t pCount, PcmStats &pStats) {
+    size_t done = 0;
+
+    #ifdef PCM_X86_SIMD
+    if (pcmPitchShiftHasSimd())
+    {
+        done = pcmAnalyzeAvx2(pSrc, pCount, pStats);
+    }
+    #endif
+
+    pcmAnalyzeScalar(pSrc + done, pCount - done, pStats);
+}
+
+void pcmStatsAdd(PcmStats &pStats, const PcmStats &pOther) {
+    pStats.count += pOther.count;
+    pStats.sumAbs += pOther.sumAbs;
+    pStats.sumSquares += pOther.sumSquares;
+    pStats.sum += pOther.sum;
+    pStats.peak = std::max(pStats.peak, pOther.peak);
+}
+
+bool pcmPitchShiftHasSimd() {
+    #ifdef PCM_X86_SIMD
+    static const bool hasAvx2 = __builtin_cpu_supports("avx2");
+    return hasAvx2;
+    #else
+    return false;
+    #endif
+}
+
+static u64 pcmPitchShiftStep(size_t pSrcCount, size_t pDstCount) {
+    return (((u64) pSrcCount - 1) << 32) / ((u64) pDstCount - 1);
+}
+
+// covers the degenerate sizes so the kernels can assume pSrcCount >= 2 and pDstCount >= 2
+static bool pcmPitchShiftTrivial(const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount) {
+    if (pDstCount == 0)
+    {
+        return true;
+    }
+
+    if (pSrcCount < 2 || pDstCount < 2)
+    {
+        s16 value = pSrcCount == 0 ? 0 : pSrc[0];
+        for (size_t j = 0; j < pDstCount; ++j)
+        {
+            pDst[j] = value;
+        }
+
+        return true;
+    }
+
+    return false;
+}
+
+void pcmPitchShiftLinearScalar(const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount) {
+    if (pcmPitchShiftTrivial(pSrc, pSrcCount, pDst, pDstCount))
+    {
+        return;
+    }
+
+    u64 step = pcmPitchShiftStep(pSrcCount, pDstCount);
+    for (size_t j = 0; j < pDstCount; ++j)
+    {
+        pDst[j] = pcmLerpFixed(pSrc, pSrcCount, j * step);
+    }
+}
+
+void pcmPitchShift(const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount, pcmInterpolation pInterpolation) {
+    if (pcmPitchShiftTrivial(pSrc, pSrcCount, pDst, pDstCount))
+    {
+        return;
+    }
+
+    u64    step = pcmPitchShiftStep(pSrcCount, pDstCount);
+    size_t j    = 0;
+
+    if (pInterpolation == PCM_INTERPOLATION_CUBIC)
+    {
+        for (; j < pDstCount; ++j)
+        {
+            pDst[j] = pcmCubic(pSrc, pSrcCount, j * step);
+        }
+
+        return;
+    }
+
+    #ifdef PCM_X86_SIMD
+    if (pcmPitchShiftHasSimd() && pSrcCount < 0x80000000)
+    {
+        // only the last output can land on the final source sample, everything before it is safe to gather
+        j = pcmPitchShiftLinearAvx2(pSrc, pDst, pDstCount - 1, step);
+    }
+    #endif
+
+    for (; j < pDstCount; ++j)
+    {
+        pDst[j] = pcmLerpFixed(pSrc, pSrcCount, j * step);
+    }
+}
+
+u64 pcmPlaybackStep(int pSemitones) {
+    return (u64) std::llround(pcmSemitoneRatio(pSemitones) * 4294967296.0);
+}
+
+size_t pcmPlaybackRender(const s16 *pSrc, size_t pSrcCount, u64 pStep, u64 &pPos, s16 *pDst, size_t pDstCount,
+                         u32 pLoopStart, u32 pLoopDuration) {
+    if (pSrcCount == 0)
+    {
+        return 0;
+    }
+
+    bool looping = pLoopDuration != 0 && (u64) pLoopStart + pLoopDuration <= pSrcCount;
+    u64  loopEnd = ((u64) pLoopStart + pLoopDuration) << 32;
+    u64  loopLen = (u64) pLoopDuration << 32;
+    u64  end     = (u64) (pSrcCount - 1) << 32;
+
+    size_t j = 0;
+    for (; j < pDstCount; ++j)
+    {
+        if (looping)
+        {
+            while (pPos >= loopEnd)
+            {
+                pPos -= loopLen;
+            }
+        }
+        else if (pPos > end)
+        {
+            break;
+        }
+
+        pDst[j] = pcmLerpFixed(pSrc, pSrcCount, pPos);
+        pPos += pStep;
+    }
+
+    return j;
+}
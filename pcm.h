@@ -10,6 +10,54 @@
 
 #include "types.h"
 
+#define PCM_SEMITONE_TABLE_RANGE 127
+
+typedef enum {
+    PCM_INTERPOLATION_LINEAR, // fixed point lerp, vectorized where the cpu allows it
+    PCM_INTERPOLATION_CUBIC,  // 4 point catmull-rom, slower but less aliasing on large shifts
+} pcmInterpolation;
+
 void pcmResample(std::vector<s16> pPcmData, int pSampleRateIn, std::vector<s16> &pPcmOut, int pSampleRateOut);
 
+// 2^(pSemitones / 12) from a precomputed table, pSemitones in [-PCM_SEMITONE_TABLE_RANGE, PCM_SEMITONE_TABLE_RANGE]
+f64 pcmSemitoneRatio(int pSemitones);
+
+// length of a sample of pSrcCount samples after shifting it up by pSemitones (negative shifts lengthen it)
+size_t pcmPitchShiftLength(size_t pSrcCount, int pSemitones);
+
+// stretches pSrc over pDst so that the first and last samples line up exactly, never reads outside pSrc
+void pcmPitchShift(const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount, pcmInterpolation pInterpolation);
+
+// reference kernel, pcmPitchShift with PCM_INTERPOLATION_LINEAR produces the same output
+void pcmPitchShiftLinearScalar(const s16 *pSrc, size_t pSrcCount, s16 *pDst, size_t pDstCount);
+
+bool pcmPitchShiftHasSimd();
+
+// running sums over a stretch of pcm, stretches combine by adding every field (and taking the larger peak)
+struct PcmStats {
+    u64 count;
+    u64 sumAbs;
+    u64 sumSquares;
+    s64 sum;
+    u32 peak; // largest |sample|, 32768 for a full scale negative one
+};
+
+// adds pSrc to pStats in a single pass over it, vectorized where the cpu allows it
+void pcmAnalyze(const s16 *pSrc, size_t pCount, PcmStats &pStats);
+
+// reference kernel, pcmAnalyze produces the same sums
+void pcmAnalyzeScalar(const s16 *pSrc, size_t pCount, PcmStats &pStats);
+
+// adds the stretch measured in pOther to pStats
+void pcmStatsAdd(PcmStats &pStats, const PcmStats &pOther);
+
+// reference for the on-device resampling of virtually filled keys (sfsKeyProximityTableEntryVelocity.semitoneOffset).
+// a voice keeps a 32.32 fixed point source position and advances it by pcmPlaybackStep() per output sample.
+u64 pcmPlaybackStep(int pSemitones);
+
+// renders up to pDstCount samples starting at pPos, wrapping into the loop once the position passes its end when
+// pLoopDuration != 0. returns the number of samples written, fewer than pDstCount once a one-shot sample runs out.
+size_t pcmPlaybackRender(const s16 *pSrc, size_t pSrcCount, u64 pStep, u64 &pPos, s16 *pDst, size_t pDstCount,
+                         u32 pLoopStart, u32 pLoopDuration);
+
 #endif //PCM_H
@@ -0,0 +1,254 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <algorithm>
+#include <string>
+#include <tuple>
+
+#include "pcm_layout.h"
+
+#include "sfs_image.h"
+
+u32 PcmLayout::resolveSample(const sfsKeyProximityTable &pTable, u8 pMidiKey, u8 pMidiVelocity) {
+    int key = pMidiKey - PCM_LAYOUT_MIDI_KEY_OFFSET;
+    if (key < SFS_FIRST_KEY || key > SFS_LAST_KEY)
+    {
+        return PCM_LAYOUT_NO_SAMPLE;
+    }
+
+    // layers are sorted by velocity, the first one loud enough plays, the loudest one above that
+    const auto &entries  = pTable.masterEntries[key - SFS_FIRST_KEY].byVelocity;
+    u32         velocity = pMidiVelocity * 2;
+    u32         found    = PCM_LAYOUT_NO_SAMPLE;
+
+    for (const auto &entry: entries)
+    {
+        if (entry.velocity == SFS_INVALID_VELOCITY)
+        {
+            break;
+        }
+
+        found = pTable.sampleIdxOrigin + entry.sampleIdx;
+        if (entry.velocity >= velocity)
+        {
+            break;
+        }
+    }
+
+    return found;
+}
+
+std::vector<u32> PcmLayout::traceSamples(const std::vector<MidiNoteOn> &pNotes, const sfsKeyProximityTable *pTables, size_t pTableCount,
+                                         int pInstrument) {
+    std::vector<u32> samples;
+    samples.reserve(pNotes.size());
+
+    for (const auto &note: pNotes)
+    {
+        size_t instrument = pInstrument < 0 ? note.channel : pInstrument;
+        if (instrument >= pTableCount)
+        {
+            continue;
+        }
+
+        u32 sample = resolveSample(pTables[instrument], note.key, note.velocity);
+        if (sample != PCM_LAYOUT_NO_SAMPLE)
+        {
+            samples.push_back(sample);
+        }
+    }
+
+    return samples;
+}
+
+std::vector<u32> PcmLayout::order(pcmLayoutPolicy pPolicy, const std::vector<PcmLayoutSample> &pSamples, const std::vector<u32> &pTraceSamples) {
+    std::vector<u32> stored;
+    for (u32 i = 0; i < pSamples.size(); i++)
+    {
+        if (pSamples[i].owner == i)
+        {
+            stored.push_back(i);
+        }
+    }
+
+    switch (pPolicy)
+    {
+        case PCM_LAYOUT_INSTRUMENT:
+            break;
+
+        case PCM_LAYOUT_VELOCITY:
+            std::ranges::stable_sort(stored, [&](u32 a, u32 b) {
+                const auto &sa = pSamples[a], &sb = pSamples[b];
+                return std::tie(sa.instrumentIdx, sa.velocity, sa.semitone) < std::tie(sb.instrumentIdx, sb.velocity, sb.semitone);
+            });
+            break;
+
+        case PCM_LAYOUT_KEY:
+            std::ranges::stable_sort(stored, [&](u32 a, u32 b) {
+                const auto &sa = pSamples[a], &sb = pSamples[b];
+                return std::tie(sa.semitone, sa.velocity, sa.instrumentIdx) < std::tie(sb.semitone, sb.velocity, sb.instrumentIdx);
+            });
+            break;
+
+        case PCM_LAYOUT_TRACE:
+        {
+            // first use order, whatever the trace never plays keeps folder order behind it
+            std::vector<bool> placed(pSamples.size(), false);
+            std::vector<u32>  traced;
+
+            for (u32 sample: pTraceSamples)
+            {
+                u32 owner = sample < pSamples.size() ? pSamples[sample].owner : PCM_LAYOUT_NO_SAMPLE;
+                if (owner != PCM_LAYOUT_NO_SAMPLE && !placed[owner])
+                {
+                    placed[owner] = true;
+                    traced.push_back(owner);
+                }
+            }
+
+            for (u32 sample: stored)
+            {
+                if (!placed[sample])
+                {
+                    traced.push_back(sample);
+                }
+            }
+
+            stored = std::move(traced);
+            break;
+        }
+    }
+
+    return stored;
+}
+
+u32 PcmLayout::place(const std::vector<u32> &pOrder, const std::vector<PcmLayoutSample> &pSamples, u32 pBlockStart, u32 pAllocationUnitBlocks,
+                     std::vector<u32> &pOffsets, u32 &pPaddingBlocks) {
+    pOffsets.assign(pSamples.size(), 0);
+    pPaddingBlocks = 0;
+
+    u32 blk = pBlockStart;
+    for (u32 sample: pOrder)
+    {
+        u32 blocks = pSamples[sample].blocks;
+        if (pAllocationUnitBlocks != 0 && blocks >= pAllocationUnitBlocks)
+        {
+            u32 aligned = roundUpTo(blk, pAllocationUnitBlocks);
+            pPaddingBlocks += aligned - blk;
+            blk = aligned;
+        }
+
+        pOffsets[sample] = blk;
+        blk += blocks;
+    }
+
+    for (u32 i = 0; i < pSamples.size(); i++)
+    {
+        pOffsets[i] = pOffsets[pSamples[i].owner];
+    }
+
+    return blk;
+}
+
+synthErrno PcmLayout::estimate(const std::filesystem::path &pImage, const std::vector<MidiNoteOn> &pNotes, const SeekEstimateOptions &pOptions,
+                               SeekEstimate &pEstimate) {
+    pEstimate = {};
+
+    SfsImage   image;
+    synthErrno ret = image.open(pImage);
+    if (ret != SERR_OK)
+    {
+        return ret;
+    }
+
+    auto tables  = image.proximityTables();
+    auto samples = image.samples();
+
+    std::vector<std::pair<u32, u32> > batch; // block extents wanted by one chord
+    u32                               head = 0;
+
+    auto flush = [&]() {
+        std::ranges::sort(batch);
+
+        for (size_t i = 0; i < batch.size();)
+        {
+            u32 start = batch[i].first;
+            u32 end   = batch[i].second;
+
+            for (i++; i < batch.size() && batch[i].first <= end + pOptions.mergeGapBlocks; i++)
+            {
+                end = std::max(end, batch[i].second);
+            }
+
+            pEstimate.commands++;
+            pEstimate.seeks += start != head;
+            pEstimate.blocksRead += end - start;
+
+            head = end;
+        }
+
+        batch.clear();
+    };
+
+    f64 batchStart = 0;
+    for (const auto &note: pNotes)
+    {
+        pEstimate.notes++;
+
+        size_t instrument = pOptions.instrument < 0 ? note.channel : pOptions.instrument;
+        u32    sampleIdx  = instrument < tables.size() ? resolveSample(tables[instrument], note.key, note.velocity) : PCM_LAYOUT_NO_SAMPLE;
+        if (sampleIdx >= samples.size())
+        {
+            pEstimate.unmapped++;
+            continue;
+        }
+
+        if (!batch.empty() && note.time - batchStart > pOptions.chordWindow)
+        {
+            flush();
+        }
+
+        if (batch.empty())
+        {
+            batchStart = note.time;
+        }
+
+        const auto &sample = samples[sampleIdx];
+        u32         blocks = std::min<u32>(pOptions.attackBlocks, sfsSampleBlockCount(sample));
+
+        if (sfsSampleIsResident(image.header(), sample))
+        {
+            pEstimate.resident++;
+            continue;
+        }
+
+        batch.emplace_back(sample.pcmDataBlockOffset, sample.pcmDataBlockOffset + blocks);
+        pEstimate.blocksWanted += blocks;
+    }
+
+    flush();
+
+    return SERR_OK;
+}
+
+bool PcmLayout::parsePolicy(const std::string &pName, pcmLayoutPolicy &pPolicy) {
+    static const std::pair<const char *, pcmLayoutPolicy> names[] = {
+        {"instrument", PCM_LAYOUT_INSTRUMENT},
+        {"velocity", PCM_LAYOUT_VELOCITY},
+        {"key", PCM_LAYOUT_KEY},
+        {"trace", PCM_LAYOUT_TRACE},
+    };
+
+    for (const auto &[name, policy]: names)
+    {
+        if (pName == name)
+        {
+            pPolicy = policy;
+            return true;
+        }
+    }
+
+    return false;
+}
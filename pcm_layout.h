@@ -0,0 +1,79 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef PCM_LAYOUT_H
+#define PCM_LAYOUT_H
+
+#include <filesystem>
+#include <vector>
+
+#include "midi_trace.h"
+#include "types.h"
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+#define PCM_LAYOUT_MIDI_KEY_OFFSET 12 // midi note 12 is TONE_OFFSET_C0
+#define PCM_LAYOUT_NO_SAMPLE 0xFFFFFFFFu
+
+typedef enum {
+    PCM_LAYOUT_INSTRUMENT, // instrument, key, velocity: folder scan order, what every image used to have
+    PCM_LAYOUT_VELOCITY,   // instrument, velocity, key: playing at one dynamic stays in one region of the card
+    PCM_LAYOUT_KEY,        // key, velocity, instrument: layered instruments playing the same key sit together
+    PCM_LAYOUT_TRACE,      // order of first use in a midi trace, samples triggered together end up adjacent
+} pcmLayoutPolicy;
+
+struct PcmLayoutSample {
+    u32 instrumentIdx;
+    u8  semitone;
+    u8  velocity;
+    u32 blocks;
+    u32 owner; // sample whose pcm this one plays, itself unless deduplicated
+};
+
+struct SeekEstimateOptions {
+    int instrument     = -1;    // play the whole trace on one instrument, -1 maps midi channel n to instrument n
+    u32 attackBlocks   = 32;    // what a voice reads from the card when it starts
+    f64 chordWindow    = 0.010; // note ons closer than this are read as one batch, sorted by block
+    u32 mergeGapBlocks = 8;     // reading through a gap this small is cheaper than another read command
+};
+
+struct SeekEstimate {
+    size_t notes;
+    size_t unmapped; // no instrument on the channel or no sample on the key
+    size_t resident; // played from the resident region, no read at all
+    size_t commands; // multi block reads issued
+    size_t seeks;    // commands that do not continue where the previous one stopped
+    u64    blocksWanted;
+    u64    blocksRead; // wanted plus the gaps read through
+};
+
+class PcmLayout {
+public:
+    // sample index the device plays for a midi note, PCM_LAYOUT_NO_SAMPLE when there is none
+    static u32 resolveSample(const sfsKeyProximityTable &pTable, u8 pMidiKey, u8 pMidiVelocity);
+
+    // the samples pNotes trigger, in order, unmapped notes left out
+    static std::vector<u32> traceSamples(const std::vector<MidiNoteOn> &pNotes, const sfsKeyProximityTable *pTables, size_t pTableCount,
+                                         int pInstrument);
+
+    // storage order of the samples that own their pcm, pTraceSamples is only used by PCM_LAYOUT_TRACE
+    static std::vector<u32> order(pcmLayoutPolicy pPolicy, const std::vector<PcmLayoutSample> &pSamples, const std::vector<u32> &pTraceSamples);
+
+    // absolute block offsets for every sample, stored ones packed from pBlockStart in pOrder and the rest sharing
+    // their owner's. samples of at least one allocation unit start on a unit boundary so they span as few erase
+    // blocks as possible, 0 disables it. returns the first block after the pcm
+    static u32 place(const std::vector<u32> &pOrder, const std::vector<PcmLayoutSample> &pSamples, u32 pBlockStart, u32 pAllocationUnitBlocks,
+                     std::vector<u32> &pOffsets, u32 &pPaddingBlocks);
+
+    // replays pNotes against a built image and counts the sd commands and seeks a voice start costs
+    static synthErrno estimate(const std::filesystem::path &pImage, const std::vector<MidiNoteOn> &pNotes, const SeekEstimateOptions &pOptions,
+                               SeekEstimate &pEstimate);
+
+    static bool parsePolicy(const std::string &pName, pcmLayoutPolicy &pPolicy);
+};
+
+#endif //PCM_LAYOUT_H
@@ -0,0 +1,208 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "proximity_table.h"
+
+#include <cstring>
+
+static const std::pair<const char *, sfsProximityEncoding> proximityEncodingNames[] = {
+    {"full", SFS_PROXIMITY_FULL},
+    {"compact", SFS_PROXIMITY_COMPACT},
+};
+
+// one way of storing pTable, false when a transposed offset does not fit
+static bool encode(const sfsKeyProximityTable &pTable, bool pTransposes, std::vector<u8> &pOut) {
+    sfsCompactProximityTable table = {};
+    table.sampleIdxOrigin          = pTable.sampleIdxOrigin;
+    table.flags                    = pTransposes ? SFS_PROXIMITY_TRANSPOSES : (sfsProximityFlags) 0;
+
+    std::vector<sfsCompactProximityMap>            maps;
+    std::vector<sfsKeyProximityTableEntryVelocity> layers;
+
+    for (u32 key = 0; key < SFS_KEY_COUNT; key++)
+    {
+        sfsKeyProximityTableEntryVelocity keyLayers[SFS_MAX_VELOCITY_COUNT];
+        u8                                count = 0;
+
+        for (const auto &entry: pTable.masterEntries[key].byVelocity)
+        {
+            if (entry.velocity == SFS_INVALID_VELOCITY)
+            {
+                break;
+            }
+
+            keyLayers[count] = entry;
+            if (pTransposes)
+            {
+                int offset = entry.semitoneOffset - (int) key;
+                if (offset < -128 || offset > 127)
+                {
+                    return false;
+                }
+
+                keyLayers[count].semitoneOffset = offset;
+            }
+
+            count++;
+        }
+
+        // usually the previous key's map, but a key can return to any earlier one
+        size_t map = 0;
+        while (map < maps.size() && (maps[map].layerCount != count ||
+                                     memcmp(&layers[maps[map].layerStart], keyLayers, count * sizeof(sfsKeyProximityTableEntryVelocity)) != 0))
+        {
+            map++;
+        }
+
+        if (map == maps.size())
+        {
+            maps.push_back({(u16) layers.size(), count, 0});
+            layers.insert(layers.end(), keyLayers, keyLayers + count);
+        }
+
+        table.keyMaps[key] = map;
+    }
+
+    table.mapCount = maps.size();
+
+    auto append = [&](const void *pData, size_t pSize) {
+        pOut.insert(pOut.end(), (const u8 *) pData, (const u8 *) pData + pSize);
+    };
+
+    append(&table, sizeof(table));
+    append(maps.data(), maps.size() * sizeof(sfsCompactProximityMap));
+    append(layers.data(), layers.size() * sizeof(sfsKeyProximityTableEntryVelocity));
+
+    return true;
+}
+
+void ProximityTable::compact(const sfsKeyProximityTable &pTable, std::vector<u8> &pOut) {
+    std::vector<u8> plain, transposed;
+
+    encode(pTable, false, plain);
+    if (encode(pTable, true, transposed) && transposed.size() < plain.size())
+    {
+        plain.swap(transposed);
+    }
+
+    pOut.insert(pOut.end(), plain.begin(), plain.end());
+    pOut.resize(roundUpTo(pOut.size(), sizeof(u32)), 0);
+}
+
+std::vector<u8> ProximityTable::compactSection(const std::vector<sfsKeyProximityTable> &pTables) {
+    std::vector<u32> offsets;
+    std::vector<u8>  tables;
+
+    u32 offsetBytes = (pTables.size() + 1) * sizeof(u32);
+    for (const auto &table: pTables)
+    {
+        offsets.push_back(offsetBytes + tables.size());
+        compact(table, tables);
+    }
+
+    offsets.push_back(offsetBytes + tables.size());
+
+    std::vector<u8> section((const u8 *) offsets.data(), (const u8 *) (offsets.data() + offsets.size()));
+    section.insert(section.end(), tables.begin(), tables.end());
+
+    return section;
+}
+
+sfsKeyProximityTableEntryVelocity ProximityTable::lookup(const sfsCompactProximityTable *pTable, u32 pKey, u32 pLayer) {
+    return sfsCompactProximityLookup(pTable, pKey, pLayer);
+}
+
+bool ProximityTable::expand(const u8 *pData, size_t pSize, sfsKeyProximityTable &pOut) {
+    if (pSize < sizeof(sfsCompactProximityTable))
+    {
+        return false;
+    }
+
+    const auto *table = (const sfsCompactProximityTable *) pData;
+    size_t      fixed = sizeof(sfsCompactProximityTable) + table->mapCount * sizeof(sfsCompactProximityMap);
+    if (pSize < fixed)
+    {
+        return false;
+    }
+
+    size_t layers = (pSize - fixed) / sizeof(sfsKeyProximityTableEntryVelocity);
+    for (u32 i = 0; i < table->mapCount; i++)
+    {
+        const auto &map = sfsCompactProximityMaps(table)[i];
+        if (map.layerCount > SFS_MAX_VELOCITY_COUNT || (size_t) map.layerStart + map.layerCount > layers)
+        {
+            return false;
+        }
+    }
+
+    pOut                 = {};
+    pOut.sampleIdxOrigin = table->sampleIdxOrigin;
+
+    for (u32 key = 0; key < SFS_KEY_COUNT; key++)
+    {
+        if (table->keyMaps[key] >= table->mapCount)
+        {
+            return false;
+        }
+
+        for (u32 layer = 0; layer < sfsCompactProximityKeyMap(table, key).layerCount; layer++)
+        {
+            pOut.masterEntries[key].byVelocity[layer] = lookup(table, key, layer);
+        }
+    }
+
+    return true;
+}
+
+bool ProximityTable::expandSection(const u8 *pData, size_t pSize, size_t pCount, std::vector<sfsKeyProximityTable> &pOut, size_t &pBytes) {
+    size_t offsetBytes = (pCount + 1) * sizeof(u32);
+    if (pSize < offsetBytes)
+    {
+        return false;
+    }
+
+    const auto *offsets = (const u32 *) pData;
+    if (offsets[0] != offsetBytes)
+    {
+        return false;
+    }
+
+    pOut.assign(pCount, {});
+    for (size_t i = 0; i < pCount; i++)
+    {
+        if (offsets[i + 1] < offsets[i] || offsets[i + 1] > pSize || !expand(pData + offsets[i], offsets[i + 1] - offsets[i], pOut[i]))
+        {
+            return false;
+        }
+    }
+
+    pBytes = offsets[pCount];
+    return true;
+}
+
+bool ProximityTable::parseEncoding(const std::string &pName, sfsProximityEncoding &pEncoding) {
+    for (const auto &[name, encoding]: proximityEncodingNames)
+    {
+        if (pName == name)
+        {
+            pEncoding = encoding;
+            return true;
+        }
+    }
+
+    return false;
+}
+
+const char *ProximityTable::encodingName(sfsProximityEncoding pEncoding) {
+    for (const auto &[name, encoding]: proximityEncodingNames)
+    {
+        if (pEncoding == encoding)
+        {
+            return name;
+        }
+    }
+
+    return "unknown";
+}
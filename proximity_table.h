@@ -0,0 +1,41 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef PROXIMITY_TABLE_H
+#define PROXIMITY_TABLE_H
+
+#include <string>
+#include <vector>
+
+#include "types.h"
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+// the compact proximity table encoding, see sfsCompactProximityTable
+class ProximityTable {
+public:
+    // the compact form of pTable appended to pOut, padded to 4 bytes. both ways of storing semitone offsets are tried
+    // and the smaller one kept, keys past the first unused layer are expected to be zeroed as mkimg leaves them
+    static void compact(const sfsKeyProximityTable &pTable, std::vector<u8> &pOut);
+
+    // the SFS_PROXIMITY_COMPACT section for pTables, offsets and tables
+    static std::vector<u8> compactSection(const std::vector<sfsKeyProximityTable> &pTables);
+
+    // sfsCompactProximityLookup, what the device runs
+    static sfsKeyProximityTableEntryVelocity lookup(const sfsCompactProximityTable *pTable, u32 pKey, u32 pLayer);
+
+    // the full table back from a compact one of pSize bytes, false when it is malformed
+    static bool expand(const u8 *pData, size_t pSize, sfsKeyProximityTable &pOut);
+
+    // every table of a SFS_PROXIMITY_COMPACT section of at most pSize bytes, pBytes gets the bytes it really takes
+    static bool expandSection(const u8 *pData, size_t pSize, size_t pCount, std::vector<sfsKeyProximityTable> &pOut, size_t &pBytes);
+
+    static bool        parseEncoding(const std::string &pName, sfsProximityEncoding &pEncoding);
+    static const char *encodingName(sfsProximityEncoding pEncoding);
+};
+
+#endif //PROXIMITY_TABLE_H
@@ -0,0 +1,69 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <algorithm>
+
+#include "resident_plan.h"
+
+ResidentPlanResult ResidentPlan::plan(const std::vector<ResidentCandidate> &pCandidates, u32 pBudgetBlocks) {
+    ResidentPlanResult result = {};
+    result.unitBlocks         = 1;
+
+    // samples that never play or could never fit only make the table bigger
+    std::vector<const ResidentCandidate *> items;
+    for (const auto &candidate: pCandidates)
+    {
+        result.allTriggers += candidate.triggers;
+        if (candidate.triggers > 0 && candidate.blocks != 0 && candidate.blocks <= pBudgetBlocks)
+        {
+            items.push_back(&candidate);
+        }
+    }
+
+    if (items.empty())
+    {
+        return result;
+    }
+
+    u64 cells         = (u64) items.size() * ((u64) pBudgetBlocks + 1);
+    result.unitBlocks = std::max<u64>(1, (cells + RESIDENT_PLAN_MAX_CELLS - 1) / RESIDENT_PLAN_MAX_CELLS);
+
+    u32 units = pBudgetBlocks / result.unitBlocks;
+
+    // best[c] is the most value that fits in c units with the items so far, keep[i][c] whether item i is part of it
+    std::vector<f64>  best(units + 1, 0);
+    std::vector<bool> keep(items.size() * ((size_t) units + 1), false);
+
+    for (size_t i = 0; i < items.size(); i++)
+    {
+        u32 weight = (items[i]->blocks + result.unitBlocks - 1) / result.unitBlocks;
+        f64 value  = items[i]->triggers * (RESIDENT_PLAN_COMMAND_BLOCKS + items[i]->blocks);
+
+        for (u32 c = units; c >= weight; c--)
+        {
+            if (best[c - weight] + value > best[c])
+            {
+                best[c]                            = best[c - weight] + value;
+                keep[i * ((size_t) units + 1) + c] = true;
+            }
+        }
+    }
+
+    u32 c = units;
+    for (size_t i = items.size(); i-- > 0;)
+    {
+        if (keep[i * ((size_t) units + 1) + c])
+        {
+            result.samples.push_back(items[i]->sample);
+            result.blocks   += items[i]->blocks;
+            result.triggers += items[i]->triggers;
+
+            c -= (items[i]->blocks + result.unitBlocks - 1) / result.unitBlocks;
+        }
+    }
+
+    std::ranges::reverse(result.samples);
+    return result;
+}
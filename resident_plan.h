@@ -0,0 +1,39 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef RESIDENT_PLAN_H
+#define RESIDENT_PLAN_H
+
+#include <vector>
+
+#include "types.h"
+
+#define RESIDENT_PLAN_COMMAND_BLOCKS 32    // bus time of a command and its seek, in blocks of data
+#define RESIDENT_PLAN_MAX_CELLS (1u << 24) // knapsack table size, larger budgets are planned in coarser units
+
+struct ResidentCandidate {
+    u32 sample; // one that owns its pcm
+    u32 blocks;
+    f64 triggers; // expected, only relative to the other candidates
+};
+
+struct ResidentPlanResult {
+    std::vector<u32> samples; // chosen, in candidate order
+    u64              blocks;
+    f64              triggers;    // of the chosen samples
+    f64              allTriggers; // of every candidate
+    u32              unitBlocks;  // the budget was planned in units of this many blocks
+};
+
+// which whole samples go into the resident region the device loads at boot. a resident sample saves a command and
+// its blocks on every trigger, so its value is triggers * (RESIDENT_PLAN_COMMAND_BLOCKS + blocks) and its weight
+// its size. the best set under the budget is a 0/1 knapsack, solved exactly when the table fits in
+// RESIDENT_PLAN_MAX_CELLS and otherwise on sizes rounded up to a coarser unit, which stays within the budget.
+class ResidentPlan {
+public:
+    static ResidentPlanResult plan(const std::vector<ResidentCandidate> &pCandidates, u32 pBudgetBlocks);
+};
+
+#endif //RESIDENT_PLAN_H
@@ -0,0 +1,157 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <cstring>
+#include <functional>
+
+#include "riff_reader.h"
+
+extern "C" {
+#include <wav/wav.h>
+}
+
+typedef pstruct {
+    u32 magic;
+    u32 size;
+} riffChunkHeader;
+
+typedef pstruct {
+    u16 format;
+    u16 channels;
+    u32 sampleRate;
+    u32 dataRate;
+    u16 align;
+    u16 bitsPerSample;
+} riffFmtChunk;
+
+typedef pstruct {
+    u32 manufacturer;
+    u32 product;
+    u32 samplePeriod;
+    u32 midiUnityNote;
+    u32 midiPitchFraction;
+    u32 smpteFormat;
+    u32 smpteOffset;
+    u32 loopCount;
+    u32 samplerData;
+
+    // first loop only
+    u32 cuePointId;
+    u32 type;
+    u32 start;
+    u32 end;
+    u32 fraction;
+    u32 playCount;
+} riffSmplChunk;
+
+// pRead(offset, dst, len) copies len bytes at offset, false when they are not there
+static synthErrno riffParse(const std::function<bool(u64, void *, u32)> &pRead, u64 pSize, RiffWavInfo &pInfo) {
+    pInfo = {};
+
+    u32 riff[3];
+    if (!pRead(0, riff, sizeof(riff)) || riff[0] != WAV_MAGIC_RIFF || riff[2] != WAV_MAGIC_WAVE)
+    {
+        return SERR_SFS_INVALID_WAV;
+    }
+
+    bool hasFmt  = false;
+    bool hasData = false;
+
+    u64 off = sizeof(riff);
+    while (off + sizeof(riffChunkHeader) <= pSize)
+    {
+        riffChunkHeader chunk;
+        if (!pRead(off, &chunk, sizeof(chunk)))
+        {
+            break;
+        }
+
+        u64 body = off + sizeof(chunk);
+
+        if (chunk.magic == WAV_MAGIC_FMT)
+        {
+            riffFmtChunk fmt;
+            if (chunk.size < sizeof(fmt) || !pRead(body, &fmt, sizeof(fmt)))
+            {
+                return SERR_SFS_INVALID_WAV;
+            }
+
+            pInfo.format        = fmt.format;
+            pInfo.channels      = fmt.channels;
+            pInfo.sampleRate    = fmt.sampleRate;
+            pInfo.bitsPerSample = fmt.bitsPerSample;
+
+            hasFmt = true;
+        }
+        else if (chunk.magic == WAV_MAGIC_DATA)
+        {
+            pInfo.dataOffset = body;
+            pInfo.dataSize   = chunk.size;
+
+            hasData = true;
+
+            // some writers leave the size of a streamed data chunk at 0 or too large, trust the file instead. such
+            // a chunk runs to the end of the file, nothing after it can be told apart from pcm
+            if (chunk.size == 0 || body + chunk.size > pSize)
+            {
+                pInfo.dataSize = pSize - body;
+                break;
+            }
+        }
+        else if (chunk.magic == RIFF_MAGIC_SMPL)
+        {
+            riffSmplChunk smpl;
+            if (chunk.size >= sizeof(smpl) && pRead(body, &smpl, sizeof(smpl)) && smpl.loopCount > 0)
+            {
+                pInfo.hasLoop   = true;
+                pInfo.loopStart = smpl.start;
+                pInfo.loopEnd   = smpl.end;
+            }
+        }
+
+        // chunks are word aligned
+        off = body + chunk.size + (chunk.size & 1);
+    }
+
+    if (!hasFmt || !hasData)
+    {
+        return SERR_SFS_INVALID_WAV;
+    }
+
+    return SERR_OK;
+}
+
+synthErrno RiffReader::parse(std::istream &pStream, RiffWavInfo &pInfo) {
+    pStream.seekg(0, std::ios_base::end);
+    u64 size = pStream.tellg();
+
+    auto read = [&](u64 pOffset, void *pDst, u32 pLen) {
+        pStream.clear();
+        pStream.seekg(pOffset, std::ios_base::beg);
+        pStream.read((str) pDst, pLen);
+        return (u32) pStream.gcount() == pLen;
+    };
+
+    synthErrno ret = riffParse(read, size, pInfo);
+
+    pStream.clear();
+    pStream.seekg(pInfo.dataOffset, std::ios_base::beg);
+
+    return ret;
+}
+
+synthErrno RiffReader::parse(const u8 *pData, u64 pSize, RiffWavInfo &pInfo) {
+    auto read = [&](u64 pOffset, void *pDst, u32 pLen) {
+        if (pOffset + pLen > pSize)
+        {
+            return false;
+        }
+
+        memcpy(pDst, pData + pOffset, pLen);
+        return true;
+    };
+
+    return riffParse(read, pSize, pInfo);
+}
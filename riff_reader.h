@@ -0,0 +1,38 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef RIFF_READER_H
+#define RIFF_READER_H
+
+#include <istream>
+
+#include "serrno.h"
+#include "types.h"
+
+#define RIFF_MAGIC_SMPL 0x6C706D73
+
+struct RiffWavInfo {
+    u16 format;
+    u16 channels;
+    u32 sampleRate;
+    u16 bitsPerSample;
+
+    u64 dataOffset; // absolute offset of the first pcm byte
+    u32 dataSize;
+
+    // first loop of the smpl chunk, if there is one. loopEnd is inclusive like in the chunk itself
+    bool hasLoop;
+    u32  loopStart;
+    u32  loopEnd;
+};
+
+// walks the chunk list of a RIFF/WAVE file by chunk size, touching only the chunk headers and the fmt /smpl bodies
+class RiffReader {
+public:
+    static synthErrno parse(std::istream &pStream, RiffWavInfo &pInfo);
+    static synthErrno parse(const u8 *pData, u64 pSize, RiffWavInfo &pInfo);
+};
+
+#endif //RIFF_READER_H
@@ -0,0 +1,340 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <fstream>
+
+#include "json.hpp"
+
+#include "sd_sim.h"
+
+synthErrno SdSimConfig::load(const std::filesystem::path &pFile, SdSimConfig &pConfig) {
+    std::ifstream in(pFile);
+    if (!in.is_open())
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    try
+    {
+        auto json = nlohmann::json::parse(in);
+
+        pConfig.commandLatency  = json.value("commandLatencyUs", pConfig.commandLatency * 1e6) / 1e6;
+        pConfig.seekLatency     = json.value("seekLatencyUs", pConfig.seekLatency * 1e6) / 1e6;
+        pConfig.singleBlockRate = json.value("singleBlockMiBs", pConfig.singleBlockRate / (1 << 20)) * (1 << 20);
+        pConfig.multiBlockRate  = json.value("multiBlockMiBs", pConfig.multiBlockRate / (1 << 20)) * (1 << 20);
+        pConfig.queueDepth      = std::max(1u, json.value("queueDepth", pConfig.queueDepth));
+    } catch (const nlohmann::json::exception &)
+    {
+        return SERR_CMD_INVALID_ARGUMENT;
+    }
+
+    return SERR_OK;
+}
+
+// lossless frames vary in size, a voice streams them at the sample's average rate
+static f64 blocksPerSecond(const sfsInstrumentSample &pSample) {
+    if (pSample.encoding == SFS_SAMPLE_ENCODING_LOSSLESS)
+    {
+        return (f64) SFS_SAMPLERATE * std::max<u32>(1, sfsSampleBlockCount(pSample)) / std::max<u32>(1, pSample.pcmDataLengthSamples);
+    }
+
+    return (f64) SFS_SAMPLERATE / sfsSamplesPerBlock(pSample);
+}
+
+SdSimulator::SdSimulator(const SfsImage *pImage, const SdSimConfig &pConfig) {
+    image   = pImage;
+    config  = pConfig;
+    logging = false;
+
+    reset();
+}
+
+void SdSimulator::reset() {
+    busFree   = 0;
+    busy      = 0;
+    lastIssue = 0;
+    nextBlock = 0;
+
+    inFlight.clear();
+    timeline.clear();
+}
+
+f64 SdSimulator::submit(f64 pTime, u32 pBlock, u32 pCount) {
+    f64 issue = pTime;
+    if (inFlight.size() >= config.queueDepth)
+    {
+        issue = std::max(issue, inFlight.front());
+    }
+
+    while (!inFlight.empty() && inFlight.front() <= issue)
+    {
+        inFlight.pop_front();
+    }
+
+    f64 latency = config.commandLatency;
+    if (pBlock != nextBlock)
+    {
+        latency += config.seekLatency;
+    }
+
+    f64 rate  = pCount == 1 ? config.singleBlockRate : config.multiBlockRate;
+    f64 start = std::max(issue + latency, busFree);
+    f64 done  = start + (f64) pCount * BLOCK_SIZE / rate;
+
+    busFree   = done;
+    busy     += done - start;
+    lastIssue = issue;
+    nextBlock = pBlock + pCount;
+    inFlight.push_back(done);
+
+    if (logging)
+    {
+        timeline.push_back({issue, start, done, pBlock, pCount});
+    }
+
+    return done;
+}
+
+VoiceStreamResult SdSimulator::streamVoices(const std::vector<u32> &pSamples, u32 pVoices, const VoiceStreamOptions &pOptions) {
+    struct Voice {
+        u32 blockOffset, blocks; // the sample being looped
+        u32 cursor;              // next block of it to request
+        u64 requested, arrived;
+        f64 start;           // playback starts when the first fill lands, < 0 until then
+        f64 blocksPerSecond; // encoded samples play more samples out of a block
+
+        bool resident; // played from ram, never requests anything
+    };
+
+    struct Pending {
+        f64 done;
+        u32 voice, count;
+    };
+
+    reset();
+
+    VoiceStreamResult result = {};
+    auto              samples = image->samples();
+
+    std::vector<Voice> voices;
+    for (u32 i = 0; i < pVoices && !pSamples.empty(); i++)
+    {
+        const auto &sample = samples[pSamples[i % pSamples.size()]];
+
+        Voice voice           = {};
+        voice.blockOffset     = sample.pcmDataBlockOffset;
+        voice.blocks          = std::max<u32>(1, sfsSampleBlockCount(sample));
+        voice.start           = -1;
+        voice.blocksPerSecond = blocksPerSecond(sample);
+        voice.resident        = sfsSampleIsResident(image->header(), sample);
+        voices.push_back(voice);
+    }
+
+    std::deque<Pending> pending;
+    f64                 now = 0;
+
+    auto played = [&](const Voice &pVoice, f64 pTime) {
+        return pVoice.start < 0 ? 0.0 : (pTime - pVoice.start) * pVoice.blocksPerSecond;
+    };
+
+    // lands whatever has completed by pTime, a voice that played past its data underran
+    auto land = [&](f64 pTime) {
+        while (!pending.empty() && pending.front().done <= pTime)
+        {
+            auto  landed = pending.front();
+            auto &voice  = voices[landed.voice];
+            pending.pop_front();
+
+            if (voice.start >= 0 && played(voice, landed.done) > voice.arrived)
+            {
+                result.underrun     = true;
+                result.underrunTime = voice.start + voice.arrived / voice.blocksPerSecond;
+                return;
+            }
+
+            if (voice.start < 0)
+            {
+                voice.start = landed.done;
+            }
+
+            voice.arrived += landed.count;
+        }
+    };
+
+    while (now < pOptions.seconds && !voices.empty())
+    {
+        land(now);
+        if (result.underrun)
+        {
+            break;
+        }
+
+        // earliest deadline first among voices with room for a chunk, voices still waiting for their first fill go
+        // before everything
+        s64 best         = -1;
+        f64 bestDeadline = 0;
+        f64 nextRoom     = pending.empty() ? pOptions.seconds : pending.front().done;
+
+        for (size_t i = 0; i < voices.size(); i++)
+        {
+            const auto &voice = voices[i];
+            if (voice.resident)
+            {
+                continue;
+            }
+
+            if (voice.requested == 0)
+            {
+                best = i;
+                break;
+            }
+
+            if (voice.start < 0)
+            {
+                continue;
+            }
+
+            // when enough of the buffer has played out to take another chunk
+            f64 deadline = voice.start + voice.arrived / voice.blocksPerSecond;
+            f64 roomAt   = voice.start + ((f64) voice.requested + pOptions.chunkBlocks - pOptions.bufferBlocks) / voice.blocksPerSecond;
+            if (roomAt > now + SD_SIM_TIME_EPSILON)
+            {
+                nextRoom = std::min(nextRoom, roomAt);
+                continue;
+            }
+
+            if (best < 0 || deadline < bestDeadline)
+            {
+                best         = i;
+                bestDeadline = deadline;
+            }
+        }
+
+        if (best < 0)
+        {
+            now = std::max(now, nextRoom);
+            continue;
+        }
+
+        auto &voice = voices[best];
+        u32   want  = voice.requested == 0 ? pOptions.bufferBlocks : pOptions.chunkBlocks;
+        u32   count = std::min(want, voice.blocks - voice.cursor);
+
+        f64 done = submit(now, voice.blockOffset + voice.cursor, count);
+        pending.push_back({done, (u32) best, count});
+        result.commands++;
+
+        voice.requested += count;
+        voice.cursor     = (voice.cursor + count) % voice.blocks;
+
+        // the next command can only be queued once this one got a slot
+        now = std::max(now, lastIssue);
+    }
+
+    // a voice whose next chunk only lands after the window has run dry inside it all the same
+    if (!result.underrun)
+    {
+        land(pOptions.seconds);
+    }
+
+    if (!result.underrun)
+    {
+        for (const auto &voice: voices)
+        {
+            f64 dry = voice.start + voice.arrived / voice.blocksPerSecond;
+            if (voice.start >= 0 && played(voice, pOptions.seconds) > voice.arrived && (!result.underrun || dry < result.underrunTime))
+            {
+                result.underrun     = true;
+                result.underrunTime = dry;
+            }
+        }
+    }
+
+    result.busyTime = busy;
+    return result;
+}
+
+NoteOnLatencyResult SdSimulator::noteOnLatency(const std::vector<SdSimNoteOn> &pNotes, bool pPreload, const VoiceStreamOptions &pOptions) {
+    reset();
+
+    NoteOnLatencyResult result = {};
+    auto                samples = image->samples();
+    const auto         &header  = image->header();
+
+    // one multi block read per region before anything plays, the notes start on a fresh clock after them
+    if (pPreload && header.residentRegionBlockCount + header.attackRegionBlockCount != 0)
+    {
+        f64 done = 0;
+        if (header.residentRegionBlockCount != 0)
+        {
+            done = submit(done, header.residentRegionBlockStart, header.residentRegionBlockCount);
+        }
+
+        if (header.attackRegionBlockCount != 0)
+        {
+            done = submit(done, header.attackRegionBlockStart, header.attackRegionBlockCount);
+        }
+
+        result.preloadTime  = done;
+        result.preloadBytes = ((u64) header.residentRegionBlockCount + header.attackRegionBlockCount) * BLOCK_SIZE;
+        reset();
+    }
+
+    f64 latencySum = 0;
+    for (const auto &note: pNotes)
+    {
+        if (note.sample >= samples.size())
+        {
+            continue;
+        }
+
+        const auto &sample = samples[note.sample];
+        u32         blocks = std::max<u32>(1, sfsSampleBlockCount(sample));
+
+        result.notes++;
+
+        if (pPreload && sfsSampleIsResident(header, sample))
+        {
+            result.fromRam++;
+            result.resident++;
+            continue;
+        }
+
+        if (!pPreload || sample.attackBlocks == 0)
+        {
+            f64 latency = submit(note.time, sample.pcmDataBlockOffset, std::min(pOptions.bufferBlocks, blocks)) - note.time;
+
+            latencySum       += latency;
+            result.maxLatency = std::max(result.maxLatency, latency);
+            continue;
+        }
+
+        // the copy covers the start, the rest has to land before it has played out
+        result.fromRam++;
+        if (sample.attackBlocks < blocks)
+        {
+            u32 count    = std::min(pOptions.bufferBlocks, blocks - sample.attackBlocks);
+            f64 done     = submit(note.time, sample.pcmDataBlockOffset + sample.attackBlocks, count);
+            f64 deadline = note.time + sample.attackBlocks / blocksPerSecond(sample);
+
+            result.lateContinuations += done > deadline;
+        }
+    }
+
+    result.meanLatency = result.notes ? latencySum / result.notes : 0;
+    return result;
+}
+
+bool SdSimulator::saveTimeline(const std::filesystem::path &pFile) const {
+    std::ofstream out(pFile);
+    out << "issued,started,done,block,count\n";
+
+    for (const auto &command: timeline)
+    {
+        out << command.issued << ',' << command.started << ',' << command.done << ',' << command.block << ',' << command.count << '\n';
+    }
+
+    return out.good();
+}
@@ -0,0 +1,109 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef SD_SIM_H
+#define SD_SIM_H
+
+#include <deque>
+#include <filesystem>
+#include <vector>
+
+#include "sfs_image.h"
+
+#define SD_SIM_TIME_EPSILON 1e-9 // seconds, keeps rounding from stalling the clock on an instant it already reached
+
+// timing of a card on the device's bus. every command pays its latency, a read that does not continue where the last
+// one stopped pays the seek latency on top, then the data moves at the single or multi block rate
+struct SdSimConfig {
+    f64 commandLatency  = 0.000300; // seconds
+    f64 seekLatency     = 0.000700;
+    f64 singleBlockRate = 4.0 * (1 << 20); // bytes per second
+    f64 multiBlockRate  = 20.0 * (1 << 20);
+    u32 queueDepth      = 1; // commands whose latency may overlap, the data phases still take turns on the bus
+
+    // json with the same keys, latencies in microseconds and rates in MiB/s. missing keys keep their defaults
+    static synthErrno load(const std::filesystem::path &pFile, SdSimConfig &pConfig);
+};
+
+struct SdSimCommand {
+    f64 issued, started, done; // started is when its data phase got the bus
+    u32 block, count;
+};
+
+struct VoiceStreamOptions {
+    u32 bufferBlocks = 16; // ring buffer per voice
+    u32 chunkBlocks  = 4;  // blocks per refill command
+    f64 seconds      = 2.0;
+};
+
+struct VoiceStreamResult {
+    bool underrun;
+    f64  underrunTime;
+    u64  commands;
+    f64  busyTime; // bus occupied by data phases
+};
+
+#define SD_SIM_NOTE_SPACING 0.010 // seconds between the notes of a latency run without a trace
+
+struct SdSimNoteOn {
+    f64 time;
+    u32 sample;
+};
+
+struct NoteOnLatencyResult {
+    u64 notes;
+    u64 fromRam;            // started from the resident or the attack region
+    u64 resident;           // of those, the ones that never touch the card
+    u64 lateContinuations;  // of those, the ones whose streamed rest arrived after the copy played out
+    f64 meanLatency;        // seconds from note on to the first sound, 0 for notes started from ram
+    f64 maxLatency;
+    f64 preloadTime;        // reading the attack region at boot
+    u64 preloadBytes;
+};
+
+// read timing of a card, a virtual clock instead of waiting. the streaming and latency runs queue their reads
+// directly, the way the device's dma driver would
+class SdSimulator {
+private:
+    const SfsImage *image;
+    SdSimConfig     config;
+
+    f64                       busFree;   // end of the last data phase
+    f64                       busy;      // summed data phases
+    f64                       lastIssue; // when the last submitted command got a queue slot
+    u32                       nextBlock;
+    std::deque<f64>           inFlight; // completion times, at most queueDepth
+    std::vector<SdSimCommand> timeline;
+    bool                      logging;
+
+public:
+    SdSimulator(const SfsImage *pImage, const SdSimConfig &pConfig);
+
+    // queues one read at pTime, returns when its data is done
+    f64 submit(f64 pTime, u32 pBlock, u32 pCount);
+
+    // pVoices voices stream pSamples (cycled) from their first block, each looping its sample, refilled earliest
+    // deadline first. underrun is set when a voice plays past what has arrived. resident samples play from ram
+    VoiceStreamResult streamVoices(const std::vector<u32> &pSamples, u32 pVoices, const VoiceStreamOptions &pOptions);
+
+    // each note reads the first pOptions.bufferBlocks of its sample when it starts. with pPreload the resident and
+    // attack regions were read at boot, resident samples play from ram and samples with an attack copy start from
+    // ram and stream the rest behind it
+    NoteOnLatencyResult noteOnLatency(const std::vector<SdSimNoteOn> &pNotes, bool pPreload, const VoiceStreamOptions &pOptions);
+
+    void reset();
+
+    void setLogging(bool pLogging) {
+        logging = pLogging;
+    }
+
+    const std::vector<SdSimCommand> &commands() const {
+        return timeline;
+    }
+
+    bool saveTimeline(const std::filesystem::path &pFile) const;
+};
+
+#endif //SD_SIM_H
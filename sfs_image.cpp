@@ -0,0 +1,261 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include <cstring>
+#include <functional>
+
+#include "sfs_image.h"
+
+#include "adpcm.h"
+#include "lossless.h"
+#include "block_cache.h"
+#include "proximity_table.h"
+
+SfsImage::SfsImage() {
+    hdr         = nullptr;
+    sampleCount = 0;
+    holdStride  = 0;
+    tables      = nullptr;
+    tableBytes  = 0;
+}
+
+synthErrno SfsImage::open(const std::filesystem::path &pFile) {
+    close();
+
+    if (!file.open(pFile))
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    if (file.size() < BLOCK_SIZE || file.at<sfsHeader>(0)->magic != SFS_MAGIC)
+    {
+        file.close();
+        return SERR_SFS_INVALID_IMAGE;
+    }
+
+    const auto &header = *file.at<sfsHeader>(0);
+
+    // sections follow each other in header order, the proximity tables are last and must fit in the file
+    const u32 starts[] = {
+        header.holdBehaviorDataStart, header.pcmDataBlockStart, header.stringLutBlockStart, header.stringDataBlockStart,
+        header.instrumentInfoDataBlockStart, header.sampleInfoBlockStart, header.proximityTableBlockStart,
+    };
+
+    bool valid = starts[0] >= 1;
+    for (size_t i = 1; i < std::size(starts); i++)
+    {
+        valid = valid && starts[i] >= starts[i - 1];
+    }
+
+    u64 tablesStart = (u64) header.proximityTableBlockStart * BLOCK_SIZE;
+    u64 tablesEnd   = tablesStart + (u64) header.singleInstrumentCount * sizeof(sfsKeyProximityTable);
+
+    tables     = (const sfsKeyProximityTable *) (file.data() + tablesStart);
+    tableBytes = tablesEnd - tablesStart;
+
+    // compact tables end where their offsets say, they must not run into whatever follows them
+    if (header.proximityTableEncoding == SFS_PROXIMITY_COMPACT)
+    {
+        u64 limit = file.size();
+        limit     = header.attackRegionBlockCount != 0 ? std::min<u64>(limit, (u64) header.attackRegionBlockStart * BLOCK_SIZE) : limit;
+        limit     = header.crcTableBlockStart != 0 ? std::min<u64>(limit, (u64) header.crcTableBlockStart * BLOCK_SIZE) : limit;
+
+        valid = valid && tablesStart <= limit &&
+                ProximityTable::expandSection(file.data() + tablesStart, limit - tablesStart, header.singleInstrumentCount, expandedTables, tableBytes);
+
+        tables    = expandedTables.data();
+        tablesEnd = tablesStart + tableBytes;
+    }
+    else
+    {
+        valid = valid && header.proximityTableEncoding == SFS_PROXIMITY_FULL;
+    }
+
+    u64 holdBytes = sectionBytes(header.holdBehaviorDataStart, header.pcmDataBlockStart);
+    u64 stride    = header.holdBehaviourStride ? header.holdBehaviourStride : 1;
+
+    valid = valid && tablesEnd <= file.size();
+    valid = valid && (u64) header.singleInstrumentCount * sizeof(sfsSingleInstrument) <=
+                     sectionBytes(header.instrumentInfoDataBlockStart, header.sampleInfoBlockStart);
+    valid = valid && (u64) header.singleInstrumentCount * stride * sizeof(sfsHoldBehaviour) <= holdBytes;
+
+    // the crc table, when there is one, follows the proximity tables
+    if (header.crcTableBlockStart != 0)
+    {
+        valid = valid && header.crcExtentBlocks != 0 && (u64) header.crcTableBlockStart * BLOCK_SIZE >= tablesEnd;
+        valid = valid && (u64) header.crcTableBlockStart * BLOCK_SIZE + (u64) sfsCrcExtentCount(header) * sizeof(u32) <= file.size();
+    }
+
+    // the resident region opens the pcm data
+    if (header.residentRegionBlockCount != 0)
+    {
+        valid = valid && header.residentRegionBlockStart == header.pcmDataBlockStart;
+        valid = valid && (u64) header.residentRegionBlockStart + header.residentRegionBlockCount <= header.stringLutBlockStart;
+    }
+
+    // and the attack region sits between the two
+    if (header.attackRegionBlockCount != 0)
+    {
+        u64 attackEnd = (u64) header.attackRegionBlockStart + header.attackRegionBlockCount;
+
+        valid = valid && (u64) header.attackRegionBlockStart * BLOCK_SIZE >= tablesEnd && attackEnd * BLOCK_SIZE <= file.size();
+        valid = valid && (header.crcTableBlockStart == 0 || attackEnd <= header.crcTableBlockStart);
+    }
+
+    if (!valid)
+    {
+        file.close();
+        return SERR_SFS_INVALID_IMAGE;
+    }
+
+    hdr        = &header;
+    holdStride = stride;
+
+    // a stored sample always starts inside the pcm section, the zeroed entries padding the section never do
+    auto samplesPtr = file.at<sfsInstrumentSample>((u64) header.sampleInfoBlockStart * BLOCK_SIZE);
+    sampleCount     = sectionBytes(header.sampleInfoBlockStart, header.proximityTableBlockStart) / sizeof(sfsInstrumentSample);
+    while (sampleCount > 0 && samplesPtr[sampleCount - 1].pcmDataBlockOffset == 0)
+    {
+        sampleCount--;
+    }
+
+    return SERR_OK;
+}
+
+void SfsImage::close() {
+    file.close();
+
+    hdr         = nullptr;
+    sampleCount = 0;
+    holdStride  = 0;
+    tables      = nullptr;
+    tableBytes  = 0;
+
+    expandedTables.clear();
+}
+
+std::span<const u8> SfsImage::blocks(u32 pBlock, u32 pCount) const {
+    if ((u64) pBlock + pCount > blockCount())
+    {
+        return {};
+    }
+
+    return {blockPtr(pBlock), (size_t) pCount * BLOCK_SIZE};
+}
+
+std::span<const sfsHoldBehaviour> SfsImage::holdBehaviours(size_t pInstrument) const {
+    if (pInstrument >= hdr->singleInstrumentCount)
+    {
+        return {};
+    }
+
+    auto rows = (const sfsHoldBehaviour *) blockPtr(hdr->holdBehaviorDataStart);
+    return {rows + pInstrument * holdStride, holdStride};
+}
+
+std::string_view SfsImage::string(u32 pIdx) const {
+    u64 lutBytes  = sectionBytes(hdr->stringLutBlockStart, hdr->stringDataBlockStart);
+    u64 dataBytes = sectionBytes(hdr->stringDataBlockStart, hdr->instrumentInfoDataBlockStart);
+
+    if ((u64) pIdx * sizeof(u32) + sizeof(u32) > lutBytes)
+    {
+        return {};
+    }
+
+    u32 offset;
+    memcpy(&offset, blockPtr(hdr->stringLutBlockStart) + (u64) pIdx * sizeof(u32), sizeof(u32));
+    if (offset >= dataBytes)
+    {
+        return {};
+    }
+
+    auto str = (const char *) blockPtr(hdr->stringDataBlockStart) + offset;
+    return {str, strnlen(str, dataBytes - offset)};
+}
+
+std::span<const s16> SfsImage::pcm(const sfsInstrumentSample &pSample) const {
+    u64 start = (u64) pSample.pcmDataBlockOffset * BLOCK_SIZE;
+    u64 len   = (u64) pSample.pcmDataLengthSamples * SAMPLE_SIZE;
+
+    if (pSample.encoding != SFS_SAMPLE_ENCODING_PCM16 || pSample.pcmDataBlockOffset < hdr->pcmDataBlockStart ||
+        start + len > sectionBytes(0, hdr->stringLutBlockStart))
+    {
+        return {};
+    }
+
+    // blocks are 512 byte aligned inside a page aligned mapping, so the samples are aligned too
+    return {file.at<s16>(start), pSample.pcmDataLengthSamples};
+}
+
+std::span<const u8> SfsImage::sampleData(const sfsInstrumentSample &pSample) const {
+    u64 blocks = sfsSampleBlockCount(pSample);
+
+    if (pSample.pcmDataBlockOffset < hdr->pcmDataBlockStart || pSample.pcmDataBlockOffset + blocks > hdr->stringLutBlockStart)
+    {
+        return {};
+    }
+
+    return {blockPtr(pSample.pcmDataBlockOffset), (size_t) blocks * BLOCK_SIZE};
+}
+
+bool SfsImage::decode(const sfsInstrumentSample &pSample, std::vector<s16> &pOut) const {
+    auto data = sampleData(pSample);
+    if (data.empty() && pSample.pcmDataLengthSamples != 0)
+    {
+        return false;
+    }
+
+    pOut.resize(pSample.pcmDataLengthSamples);
+
+    switch (pSample.encoding)
+    {
+        case SFS_SAMPLE_ENCODING_PCM16:
+            memcpy(pOut.data(), data.data(), pOut.size() * SAMPLE_SIZE);
+            return true;
+        case SFS_SAMPLE_ENCODING_ADPCM:
+            adpcmDecode(data.data(), pOut.data(), pOut.size());
+            return true;
+        case SFS_SAMPLE_ENCODING_LOSSLESS:
+            return losslessDecode(data.data(), data.size(), pOut.data(), pOut.size());
+        default:
+            return false;
+    }
+}
+
+static const SfsImage *gMountedImage = nullptr;
+static BlockCache     *gMountedCache = nullptr;
+
+void sfsMountImage(const SfsImage *pImage) {
+    gMountedImage = pImage;
+}
+
+void sfsMountCache(BlockCache *pCache) {
+    gMountedCache = pCache;
+}
+
+// pByteCount is what the last block contributes, so pBlkCnt full blocks are (pBlkCnt - 1) * BLOCK_SIZE + BLOCK_SIZE
+// bytes and a single block read may run past its block, as sample reads do
+synthErrno sfsReadBlocks(u8 *pData, u32 pBlkIdx, u32 pBlkCnt, u32 pByteOffset, u32 pByteCount) {
+    if (gMountedCache)
+    {
+        return gMountedCache->read(pData, pBlkIdx, pBlkCnt, pByteOffset, pByteCount);
+    }
+
+    if (!gMountedImage || pBlkCnt == 0)
+    {
+        return SERR_SD_GENERIC_ERROR;
+    }
+
+    u64 start = (u64) pBlkIdx * BLOCK_SIZE + pByteOffset;
+    u64 len   = (u64) (pBlkCnt - 1) * BLOCK_SIZE + pByteCount;
+
+    if (start + len > gMountedImage->size())
+    {
+        return SERR_SD_READ_ERROR;
+    }
+
+    memcpy(pData, gMountedImage->data() + start, len);
+    return SERR_OK;
+}
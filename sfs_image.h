@@ -0,0 +1,138 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef SFS_IMAGE_H
+#define SFS_IMAGE_H
+
+#include <filesystem>
+#include <span>
+#include <string_view>
+#include <vector>
+
+#include "mapped_file.h"
+
+extern "C" {
+#include "sfs/sfs.h"
+}
+
+// read-only view of a synth.bin on the host. the image is memory mapped and every accessor points straight into the
+// mapping, nothing is copied but compact proximity tables, which open expands once. open checks the header and that
+// every section lies inside the file, so the accessors only bound check indices. like MappedFile, an open image can
+// be shared between threads.
+class SfsImage {
+private:
+    MappedFile file;
+
+    const sfsHeader *hdr;
+    size_t           sampleCount;
+    size_t           holdStride; // behaviours per single instrument
+
+    const sfsKeyProximityTable       *tables;
+    std::vector<sfsKeyProximityTable> expandedTables; // of a SFS_PROXIMITY_COMPACT image
+    size_t                            tableBytes;     // the proximity table section takes on the card
+
+    u64 sectionBytes(u32 pStart, u32 pEnd) const {
+        return (u64) (pEnd - pStart) * BLOCK_SIZE;
+    }
+
+    const u8 *blockPtr(u32 pBlock) const {
+        return file.data() + (u64) pBlock * BLOCK_SIZE;
+    }
+
+public:
+    SfsImage();
+
+    synthErrno open(const std::filesystem::path &pFile);
+    void       close();
+
+    bool isOpen() const {
+        return hdr != nullptr;
+    }
+
+    const sfsHeader &header() const {
+        return *hdr;
+    }
+
+    u64 size() const {
+        return file.size();
+    }
+
+    const u8 *data() const {
+        return file.data();
+    }
+
+    u32 blockCount() const {
+        return file.size() / BLOCK_SIZE;
+    }
+
+    // pCount whole blocks starting at pBlock, empty when they run past the end
+    std::span<const u8> blocks(u32 pBlock, u32 pCount) const;
+
+    std::span<const sfsSingleInstrument> instruments() const {
+        return {(const sfsSingleInstrument *) blockPtr(hdr->instrumentInfoDataBlockStart), hdr->singleInstrumentCount};
+    }
+
+    // the sample info section is padded to a block with zeroed entries, which are not counted
+    std::span<const sfsInstrumentSample> samples() const {
+        return {(const sfsInstrumentSample *) blockPtr(hdr->sampleInfoBlockStart), sampleCount};
+    }
+
+    // full tables whatever the section's encoding
+    std::span<const sfsKeyProximityTable> proximityTables() const {
+        return {tables, hdr->singleInstrumentCount};
+    }
+
+    size_t proximityTableBytes() const {
+        return tableBytes;
+    }
+
+    // crc32c of every extent of header.crcExtentBlocks blocks before the table, empty for images without one
+    std::span<const u32> crcTable() const {
+        if (hdr->crcTableBlockStart == 0)
+        {
+            return {};
+        }
+
+        return {(const u32 *) blockPtr(hdr->crcTableBlockStart), sfsCrcExtentCount(*hdr)};
+    }
+
+    // the pcm of every resident sample, see sfsSampleIsResident. empty for images without one
+    std::span<const u8> residentRegion() const {
+        return {blockPtr(hdr->residentRegionBlockStart), (size_t) hdr->residentRegionBlockCount * BLOCK_SIZE};
+    }
+
+    // copies of the first blocks of samples, see sfsInstrumentSample::attackBlocks. empty for images without one
+    std::span<const u8> attackRegion() const {
+        return {blockPtr(hdr->attackRegionBlockStart), (size_t) hdr->attackRegionBlockCount * BLOCK_SIZE};
+    }
+
+    // one row per single instrument, unused slots have instrumentId SFS_INVALID_INSTRUMENT_ID
+    std::span<const sfsHoldBehaviour> holdBehaviours(size_t pInstrument) const;
+
+    // nul terminated string pIdx of the string section, empty when out of range
+    std::string_view string(u32 pIdx) const;
+
+    std::string_view instrumentName(size_t pInstrument) const {
+        return string(instruments()[pInstrument].nameStrIndex);
+    }
+
+    // a pcm16 sample's pcm, empty when it lies outside the image or the sample is encoded
+    std::span<const s16> pcm(const sfsInstrumentSample &pSample) const;
+    std::span<const s16> pcm(size_t pSampleIdx) const {
+        return pcm(samples()[pSampleIdx]);
+    }
+
+    // the blocks a sample is stored in whatever its encoding, empty when they lie outside the image
+    std::span<const u8> sampleData(const sfsInstrumentSample &pSample) const;
+
+    // a sample's pcm decoded into pOut, false when its data lies outside the image or the encoding is unknown
+    bool decode(const sfsInstrumentSample &pSample, std::vector<s16> &pOut) const;
+};
+
+// sfsReadBlocks on the host reads from the image mounted here (nullptr unmounts), so sfs code shared with the device
+// runs unchanged
+void sfsMountImage(const SfsImage *pImage);
+
+#endif //SFS_IMAGE_H
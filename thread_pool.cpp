@@ -0,0 +1,130 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#include "thread_pool.h"
+
+#include <exception>
+
+size_t ThreadPool::resolveThreadCount(size_t pThreadCount) {
+    if (pThreadCount != 0)
+    {
+        return pThreadCount;
+    }
+
+    size_t hw = std::thread::hardware_concurrency();
+    return hw == 0 ? 1 : hw;
+}
+
+ThreadPool::ThreadPool(size_t pThreadCount) {
+    taskCount    = 0;
+    nextIdx      = 0;
+    pendingCount = 0;
+    stopping     = false;
+
+    // the thread calling parallelFor works too, so one less worker is spawned
+    size_t count = resolveThreadCount(pThreadCount) - 1;
+    for (size_t i = 0; i < count; ++i)
+    {
+        workers.emplace_back(&ThreadPool::workerLoop, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock(mutex);
+        stopping = true;
+    }
+
+    wakeCond.notify_all();
+
+    for (auto &worker: workers)
+    {
+        worker.join();
+    }
+}
+
+bool ThreadPool::runOne(std::unique_lock<std::mutex> &pLock) {
+    if (nextIdx >= taskCount)
+    {
+        return false;
+    }
+
+    size_t idx = nextIdx++;
+    auto   fn  = task;
+
+    pLock.unlock();
+    fn(idx);
+    pLock.lock();
+
+    if (--pendingCount == 0)
+    {
+        doneCond.notify_all();
+    }
+
+    return true;
+}
+
+void ThreadPool::workerLoop() {
+    std::unique_lock lock(mutex);
+
+    while (true)
+    {
+        wakeCond.wait(lock, [this] { return stopping || nextIdx < taskCount; });
+        if (stopping)
+        {
+            return;
+        }
+
+        while (runOne(lock)) {}
+    }
+}
+
+void ThreadPool::parallelFor(size_t pCount, const std::function<void(size_t)> &pFn) {
+    if (pCount == 0)
+    {
+        return;
+    }
+
+    std::exception_ptr firstError;
+    std::mutex         errorMutex;
+
+    auto guarded = [&](size_t pIdx) {
+        try
+        {
+            pFn(pIdx);
+        } catch (...)
+        {
+            std::lock_guard lock(errorMutex);
+            if (!firstError)
+            {
+                firstError = std::current_exception();
+            }
+        }
+    };
+
+    std::unique_lock lock(mutex);
+
+    task         = guarded;
+    taskCount    = pCount;
+    nextIdx      = 0;
+    pendingCount = pCount;
+
+    wakeCond.notify_all();
+
+    while (runOne(lock)) {}
+
+    doneCond.wait(lock, [this] { return pendingCount == 0; });
+
+    task      = nullptr;
+    taskCount = 0;
+    nextIdx   = 0;
+
+    lock.unlock();
+
+    if (firstError)
+    {
+        std::rethrow_exception(firstError);
+    }
+}
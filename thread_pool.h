@@ -0,0 +1,51 @@
+//
+// Created by lovro on 19/10/2026.
+// Copyright (c) 2026 lovro. All rights reserved.
+//
+
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class ThreadPool {
+private:
+    std::vector<std::thread> workers;
+
+    std::mutex              mutex;
+    std::condition_variable wakeCond;
+    std::condition_variable doneCond;
+
+    std::function<void(size_t)> task;
+    size_t                      taskCount;
+    size_t                      nextIdx;
+    size_t                      pendingCount;
+    bool                        stopping;
+
+    void workerLoop();
+    bool runOne(std::unique_lock<std::mutex> &pLock);
+
+public:
+    // pThreadCount == 0 picks std::thread::hardware_concurrency()
+    explicit ThreadPool(size_t pThreadCount);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool &)            = delete;
+    ThreadPool &operator=(const ThreadPool &) = delete;
+
+    size_t threadCount() const {
+        return workers.size() + 1;
+    }
+
+    // runs pFn(0..pCount-1) spread over the pool and the calling thread, returns once every index is done.
+    // indices are handed out in ascending order, so callers that write results by index stay deterministic.
+    void parallelFor(size_t pCount, const std::function<void(size_t)> &pFn);
+
+    static size_t resolveThreadCount(size_t pThreadCount);
+};
+
+#endif //THREAD_POOL_H